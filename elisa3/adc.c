@@ -27,6 +27,150 @@ void initAdc(void) {
 
 }
 
+void checkCliff() {
+	// the cliff avoidance behavior is inserted within this interrupt service routine in order to react
+	// as fast as possible; the maximum speed usable with cliff avoidance is 30 in all kind of surface 
+	// (apart from black ones) after calibration.
+	if(cliffAvoidanceEnabled) {
+		if(proximityResult[8]<CLIFF_THR || proximityResult[9]<CLIFF_THR || proximityResult[10]<CLIFF_THR || proximityResult[11]<CLIFF_THR) {
+		//if(proximityResult[8]<(proximityOffset[8]>>1) || proximityResult[9]<(proximityOffset[9]>>1) || proximityResult[10]<(proximityOffset[10]>>1) || proximityResult[11]<(proximityOffset[11]>>1)) {
+			cliffDetectedFlag = 1;
+			//LED_RED_ON;			
+			// set resulting velocity to 0 and change the pwm registers directly to be able
+			// to stop as fast as possible (the next pwm cycle)
+			// left motor
+			pwm_left = 0;
+			OCR4A = 0;
+			OCR4B = 0;
+			// right motor
+			pwm_right = 0;
+			OCR3A = 0;
+			OCR3B = 0;
+		} else {
+			cliffDetectedFlag = 0;
+			//LED_RED_OFF;
+		}
+	} else {
+		cliffDetectedFlag = 0;
+	}
+}
+
+void groundPulseOn(unsigned char ground) {
+	if(hardwareRevision == HW_REV_3_0) {
+		PORTJ = (1 << ground);	// pulse on
+	}
+	if(hardwareRevision == HW_REV_3_0_1) {
+		PORTJ &= ~(1 << ground);	// pulse on (inverse logic)
+	}
+	if(hardwareRevision == HW_REV_3_1) {
+		PORTJ &= ~(1 << ground);	// pulse on (inverse logic)
+	}
+}
+
+void groundPulseOff() {
+	if(hardwareRevision == HW_REV_3_0) {
+		PORTJ &= 0xF0;
+	}
+	if(hardwareRevision == HW_REV_3_0_1) {
+		PORTJ = 0xFF;
+	}
+	if(hardwareRevision == HW_REV_3_1) {
+		PORTJ = 0xFF;
+	}
+}
+
+void irCommInterleavePulse(unsigned char proxAllowed) {
+	// proximity and ground samples alternate; when the proximity can't be sampled the ground is taken instead
+	if(irCommProxEnabled && proxAllowed && (irCommInterleaveProx==0 || irCommGroundEnabled==0)) {
+		irCommInterleaveProx = 1;
+		irCommInterleaveChannel = irCommProxIndex>>1;
+		if(irCommProxIndex & 0x01) {	// active phase
+			PORTA = (1 << (irCommProxIndex>>1));
+		}
+	} else if(irCommGroundEnabled) {
+		irCommInterleaveProx = 0;
+		irCommInterleaveChannel = 8 + (irCommGroundIndex>>1);
+		if(irCommGroundIndex & 0x01) {	// active phase
+			groundPulseOn(irCommGroundIndex>>1);
+		}
+	} else {
+		return;
+	}
+	irCommInterleaveState = IRCOMM_INTERLEAVE_PULSE_ON;
+}
+
+unsigned char irCommInterleaveProxFree() {
+	unsigned char i = 0;
+	for(i=0; i<8; i++) {
+		if((irCommTxPattern & (1 << (irCommProxIndex>>1))) == 0) {
+			return 1;
+		}
+		irCommProxIndex = ((irCommProxIndex|0x01)+1)&0x0F;	// ambient phase of the next sensor
+	}
+	return 0;
+}
+
+void irCommInterleavePulseOff() {
+	if(irCommInterleaveProx) {
+		PORTA = 0x00;	// the transmission pulse is off too when a proximity is sampled
+	} else {
+		groundPulseOff();
+	}
+}
+
+void computeProximityResult(unsigned char sensor) {
+	proximityResult[sensor] = proximityValue[sensor*2] - proximityValue[sensor*2+1] - proximityOffset[sensor];	// ambient - (ambient+reflected) - offset
+	if(proximityResult[sensor] < 0) {
+		proximityResult[sensor] = 0;
+	}
+	if(proximityResult[sensor] > 1024) {
+		proximityResult[sensor] = 1024;
+	}
+
+	// linearization of the proximity values: the values of the proximity will range from 
+	// 0 to 255 after linearization and decrease linearly with distance.
+	// The linearization of the proximity values is done using four linear functions:
+	// 1) from 0 to PHASE1: y = x (where x = proximity value9
+	// 2) from PHASE1 to PHASE2: y = x/2 + 30
+	// 3) from PHASE2 to PHASE3: y = x/4 + 75
+	// 4) from PHASE3 upwards: y = x/8 + 127.5
+	// The linearized values are used for the obstacles avoidance.
+	if(sensor < 8) {	// only for proximity (not ground sensors)
+		
+		if(proximityResult[sensor] < PHASE1) {
+
+			proximityResultLinear[sensor] = proximityResult[sensor];
+
+		} else if(((proximityResult[sensor]+60)>>1) < PHASE2) {
+	
+			proximityResultLinear[sensor] = ((proximityResult[sensor]-60)>>1) + PHASE1;
+
+		} else if(((proximityResult[sensor]+300)>>2) < PHASE3) {
+
+			proximityResultLinear[sensor] = ((proximityResult[sensor]-180)>>2) + PHASE2;
+
+		} else {
+
+			proximityResultLinear[sensor] = ((proximityResult[sensor]-420)>>3) + PHASE3;
+			
+		}
+
+	}
+}
+
+void irCommTxUpdatePulse() {
+	if(irCommTxBitToTransmit[irCommTxBitCount] == IRCOMM_BIT_MANCHESTER_BLOCK) {	// level of the next half bit
+		irCommTxPulseState = (irCommTxManchester>>(irCommTxSwitchCounter+1))&0x01;
+	} else {																		// simply toggle the pulse
+		irCommTxPulseState = 1 - irCommTxPulseState;
+	}
+	if(irCommTxPulseState == 1) {
+		PORTA = irCommTxPattern;
+	} else {
+		PORTA = 0x00;
+	}
+}
+
 ISR(ADC_vect) {
 
 	// ADIF is cleared by hardware when executing the corresponding interrupt handling vector
@@ -48,6 +192,26 @@ ISR(ADC_vect) {
 		clockTick++;				// this variable is used as base time for timed processes/functions (e,g, delay); 
 	}								// resolution of 104 us based on adc interrupts
 
+	// idle fraction: adc interrupts waking up the cpu from the idle mode
+	if(cpuSleeping) {
+		idleTicks++;
+	}
+	idleMeasureTicks++;
+	if(idleMeasureTicks >= IDLE_MEASURE_PERIOD) {
+		idleTicksLast = idleTicks;
+		idleTicks = 0;
+		idleMeasureTicks = 0;
+	}
+
+	// read the radio status in background (the radio IRQ line isn't connected)
+	rfPollCounter++;
+	if(rfPollCounter >= RF_POLL_PERIOD) {
+		rfPollCounter = 0;
+		rfStartStatusPoll();
+	}
+
+	logSample();
+
 	unsigned int value = ADCL;			// get the sample; low byte must be read first!!
 	value = (ADCH<<8) | value;
 
@@ -82,73 +246,8 @@ ISR(ADC_vect) {
 			}
 
 			if(currentProx & 0x01) {
-				//if(currentProx < 16) {	// prox
-					proximityResult[currentProx>>1] = proximityValue[currentProx-1] - proximityValue[currentProx] - proximityOffset[currentProx>>1];	// ambient - (ambient+reflected) - offset
-				//} else {	// ground
-				//	proximityResult[currentProx>>1] = proximityValue[currentProx-1] - proximityValue[currentProx];
-				//}
-				if(proximityResult[currentProx>>1] < 0) {
-					proximityResult[currentProx>>1] = 0;
-				}
-				if(proximityResult[currentProx>>1] > 1024) {
-					proximityResult[currentProx>>1] = 1024;
-				}
-
-				// linearization of the proximity values: the values of the proximity will range from 
-				// 0 to 255 after linearization and decrease linearly with distance.
-				// The linearization of the proximity values is done using four linear functions:
-				// 1) from 0 to PHASE1: y = x (where x = proximity value9
-				// 2) from PHASE1 to PHASE2: y = x/2 + 30
-				// 3) from PHASE2 to PHASE3: y = x/4 + 75
-				// 4) from PHASE3 upwards: y = x/8 + 127.5
-				// The linearized values are used for the obstacles avoidance.
-				if(currentProx < 16) {	// only for proximity (not ground sensors)
-					
-					if(proximityResult[currentProx>>1] < PHASE1) {
-
-						proximityResultLinear[currentProx>>1] = proximityResult[currentProx>>1];
-
-					} else if(((proximityResult[currentProx>>1]+60)>>1) < PHASE2) {
-				
-						proximityResultLinear[currentProx>>1] = ((proximityResult[currentProx>>1]-60)>>1) + PHASE1;
-
-					} else if(((proximityResult[currentProx>>1]+300)>>2) < PHASE3) {
-
-						proximityResultLinear[currentProx>>1] = ((proximityResult[currentProx>>1]-180)>>2) + PHASE2;
-
-					} else {
-
-						proximityResultLinear[currentProx>>1] = ((proximityResult[currentProx>>1]-420)>>3) + PHASE3;
-						
-					}
-
-				}
-
-				// the cliff avoidance behavior is inserted within this interrupt service routine in order to react
-				// as fast as possible; the maximum speed usable with cliff avoidance is 30 in all kind of surface 
-				// (apart from black ones) after calibration.
-				if(cliffAvoidanceEnabled) {
-					if(proximityResult[8]<CLIFF_THR || proximityResult[9]<CLIFF_THR || proximityResult[10]<CLIFF_THR || proximityResult[11]<CLIFF_THR) {
-					//if(proximityResult[8]<(proximityOffset[8]>>1) || proximityResult[9]<(proximityOffset[9]>>1) || proximityResult[10]<(proximityOffset[10]>>1) || proximityResult[11]<(proximityOffset[11]>>1)) {
-						cliffDetectedFlag = 1;
-						//LED_RED_ON;			
-						// set resulting velocity to 0 and change the pwm registers directly to be able
-						// to stop as fast as possible (the next pwm cycle)
-						// left motor
-						pwm_left = 0;
-						OCR4A = 0;
-						OCR4B = 0;
-						// right motor
-						pwm_right = 0;
-						OCR3A = 0;
-						OCR3B = 0;
-					} else {
-						cliffDetectedFlag = 0;
-						//LED_RED_OFF;
-					}
-				} else {
-					cliffDetectedFlag = 0;
-				}
+				computeProximityResult(currentProx>>1);
+				checkCliff();
 
 			}			
 			currentProx++;
@@ -158,6 +257,26 @@ ISR(ADC_vect) {
 			}											// is sampled; thus 12 sensors x 2 phases = 24 samples
 			break;
 
+		case SAVE_TO_INTERLEAVED_IRCOMM:
+			if(irCommInterleaveProx) {
+				proximityValue[irCommProxIndex] = value;
+				if(irCommProxIndex & 0x01) {	// active phase
+					computeProximityResult(irCommProxIndex>>1);
+				}
+				irCommProxIndex = (irCommProxIndex+1)&0x0F;
+				if(irCommProxIndex == 0) {		// all the proximity sensors updated (the ground sensors are refreshed faster)
+					proxUpdated = 1;
+				}
+			} else {
+				proximityValue[16+irCommGroundIndex] = value;
+				if(irCommGroundIndex & 0x01) {	// active phase
+					computeProximityResult(8+(irCommGroundIndex>>1));
+					checkCliff();
+				}
+				irCommGroundIndex = (irCommGroundIndex+1)&0x07;
+			}
+			break;
+
 		case SAVE_TO_RIGHT_MOTOR_CURRENT:
 			right_current_avg += value;
 			right_current_avg = right_current_avg >> 1;	// the current consumption is an estimate, not really an average of the samples
@@ -252,24 +371,11 @@ ISR(ADC_vect) {
 				irCommTxDurationCycle++;
 				if(irCommTxDurationCycle == irCommTxDuration) {
 					irCommTxDurationCycle = 0;
-					if(irCommTxPulseState == 0) {
-						irCommTxPulseState = 1;
-						//PORTA = 0xFF;
-						//PORTA = 0x01;
-						//PORTA = irCommTxSensorMask;
-						if(irCommTxSensorGroup==0) {
-							PORTA = 0xAA;
-						} else {
-							PORTA = 0x55;
-						}
-					} else {
-						irCommTxPulseState = 0;
-						PORTA = 0x00;
-					}
+					irCommTxUpdatePulse();
 					irCommTxSwitchCounter++;
 					if(irCommTxSwitchCounter == irCommTxSwitchCount) {
 						irCommTxBitCount++;
-						if(irCommTxBitCount==12) {
+						if(irCommTxBitCount==irCommTxBitTotal) {
 							irCommState = IRCOMM_TX_IDLE_STATE;
 							irCommTxByteEnqueued = 0;
 							adcSamplingState = 0;
@@ -287,13 +393,27 @@ ISR(ADC_vect) {
 				}	
 				currentAdChannel = currentMotRightChannel;
 				rightChannelPhase = rightMotorPhase;
-				if(leftChannelPhase == ACTIVE_PHASE) {
+				if(irCommInterleaveState == IRCOMM_INTERLEAVE_CHANNEL_SELECTED) {
+					adcSaveDataTo = SAVE_TO_INTERLEAVED_IRCOMM;
+					irCommInterleaveState = IRCOMM_INTERLEAVE_SAMPLING;
+				} else if(leftChannelPhase == ACTIVE_PHASE) {
 					adcSaveDataTo = SAVE_TO_LEFT_MOTOR_CURRENT;
 				} else if(leftChannelPhase == PASSIVE_PHASE) {
 					adcSaveDataTo = SAVE_TO_LEFT_MOTOR_VEL;
 				} else {
 					adcSaveDataTo = SKIP_SAMPLE;
 				}
+				if((irCommGroundEnabled || irCommProxEnabled) && irCommInterleaveState==IRCOMM_INTERLEAVE_IDLE) {
+					irCommInterleaveTxCounter++;
+					if(irCommInterleaveTxCounter >= IRCOMM_INTERLEAVE_TX_PERIOD) {	// from time to time sample a sensor instead of the left motor
+						// the proximity can be sampled only while the transmission pulse is off and will stay off until the sample is taken,
+						// and only with a sensor not used by the transmission (its pulse would be sent to the neighbours as part of the data)
+						irCommInterleavePulse(irCommTxPulseState==0 && irCommTxDurationCycle>0 && (irCommTxDuration-irCommTxDurationCycle)>IRCOMM_INTERLEAVE_TX_MARGIN && irCommInterleaveProxFree());
+						if(irCommInterleaveState == IRCOMM_INTERLEAVE_PULSE_ON) {
+							irCommInterleaveTxCounter = 0;
+						}
+					}
+				}
 				irCommAdcTxState = IRCOMM_TX_ADC_TRANSMISSION_SEQ2;
 				break;
 
@@ -301,24 +421,11 @@ ISR(ADC_vect) {
 				irCommTxDurationCycle++;
 				if(irCommTxDurationCycle == irCommTxDuration) {
 					irCommTxDurationCycle = 0;
-					if(irCommTxPulseState == 0) {
-						irCommTxPulseState = 1;
-						//PORTA = 0xFF;
-						//PORTA = 0x01;
-						//PORTA = irCommTxSensorMask;
-						if(irCommTxSensorGroup==0) {
-							PORTA = 0xAA;
-						} else {
-							PORTA = 0x55;
-						}
-					} else {
-						irCommTxPulseState = 0;
-						PORTA = 0x00;
-					}
+					irCommTxUpdatePulse();
 					irCommTxSwitchCounter++;
 					if(irCommTxSwitchCounter == irCommTxSwitchCount) {
 						irCommTxBitCount++;
-						if(irCommTxBitCount==12) {
+						if(irCommTxBitCount==irCommTxBitTotal) {
 							irCommState = IRCOMM_TX_IDLE_STATE;
 							irCommTxByteEnqueued = 0;
 							adcSamplingState = 0;
@@ -334,8 +441,13 @@ ISR(ADC_vect) {
 						break;
 					}
 				}
-				currentAdChannel = currentMotLeftChannel;
-				leftChannelPhase = leftMotorPhase;
+				if(irCommInterleaveState == IRCOMM_INTERLEAVE_PULSE_ON) {
+					currentAdChannel = irCommInterleaveChannel;
+					irCommInterleaveState = IRCOMM_INTERLEAVE_CHANNEL_SELECTED;
+				} else {
+					currentAdChannel = currentMotLeftChannel;
+					leftChannelPhase = leftMotorPhase;
+				}
 				if(rightChannelPhase == ACTIVE_PHASE) {
 					adcSaveDataTo = SAVE_TO_RIGHT_MOTOR_CURRENT;
 				} else if(rightChannelPhase == PASSIVE_PHASE) {
@@ -415,12 +527,20 @@ ISR(ADC_vect) {
 				} else {
 					adcSaveDataTo = SKIP_SAMPLE;
 				}
+				if(irCommGroundEnabled || irCommProxEnabled) {	// one sensor sample per reception cycle (in place of the second left motor sample)
+					irCommInterleavePulse(1);
+				}
 				irCommAdcRxState = 9;
 				break;
 
 			case 9:
-				currentAdChannel = currentMotLeftChannel;
-				leftChannelPhase = leftMotorPhase;
+				if(irCommInterleaveState == IRCOMM_INTERLEAVE_PULSE_ON) {
+					currentAdChannel = irCommInterleaveChannel;
+					irCommInterleaveState = IRCOMM_INTERLEAVE_CHANNEL_SELECTED;
+				} else {
+					currentAdChannel = currentMotLeftChannel;
+					leftChannelPhase = leftMotorPhase;
+				}
 				if(rightChannelPhase == ACTIVE_PHASE) {
 					adcSaveDataTo = SAVE_TO_RIGHT_MOTOR_CURRENT;
 				} else if(rightChannelPhase == PASSIVE_PHASE) {
@@ -434,7 +554,10 @@ ISR(ADC_vect) {
 			case 10:
 				currentAdChannel = currentMotRightChannel;
 				rightChannelPhase = rightMotorPhase;
-				if(leftChannelPhase == ACTIVE_PHASE) {
+				if(irCommInterleaveState == IRCOMM_INTERLEAVE_CHANNEL_SELECTED) {
+					adcSaveDataTo = SAVE_TO_INTERLEAVED_IRCOMM;
+					irCommInterleaveState = IRCOMM_INTERLEAVE_SAMPLING;
+				} else if(leftChannelPhase == ACTIVE_PHASE) {
 					adcSaveDataTo = SAVE_TO_LEFT_MOTOR_CURRENT;
 				} else if(leftChannelPhase == PASSIVE_PHASE) {
 					adcSaveDataTo = SAVE_TO_LEFT_MOTOR_VEL;
@@ -674,6 +797,13 @@ ISR(ADC_vect) {
 
 	}
 
+	// turn off the ground/proximity IR pulse once the sensor conversion is started during IR communication;
+	// also abort the sample if the communication is interrupted in the middle of it
+	if(irCommInterleaveState==IRCOMM_INTERLEAVE_SAMPLING || (irCommInterleaveState!=IRCOMM_INTERLEAVE_IDLE && irCommMode==IRCOMM_MODE_SENSORS_SAMPLING)) {
+		irCommInterleavePulseOff();
+		irCommInterleaveState = IRCOMM_INTERLEAVE_IDLE;
+	}
+
 	//LED_BLUE_OFF;
 
 }
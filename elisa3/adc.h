@@ -26,6 +26,7 @@
 #include <string.h>
 #include "utility.h"
 #include "irCommunication.h"
+#include "logger.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,6 +38,61 @@ extern "C" {
  */
 void initAdc();
 
+/**
+ * \brief Update the IR pulse during transmission (called from the adc isr): toggle the IR for the start and frequency 
+ * encoded bits, or set the level of the next half bit for the Manchester encoded bits.
+ * \return none
+ */
+void irCommTxUpdatePulse();
+
+/**
+ * \brief Check the ground sensors values and stop the motors immediately if a cliff is detected (when cliff avoidance is enabled).
+ * \return none
+ */
+void checkCliff();
+
+/**
+ * \brief Turn on the IR pulse of the ground sensor passed as argument, taking care of the hardware revision.
+ * \param ground ground sensor (0..3)
+ * \return none
+ */
+void groundPulseOn(unsigned char ground);
+
+/**
+ * \brief Turn off the IR pulses of all the ground sensors, taking care of the hardware revision.
+ * \return none
+ */
+void groundPulseOff();
+
+/**
+ * \brief Compute the proximity value (ambient - reflected - offset) of the sensor passed as argument from its
+ * last two samples; the linearized value is computed too for the proximity sensors.
+ * \param sensor sensor index (0..7 proximity, 8..11 ground)
+ * \return none
+ */
+void computeProximityResult(unsigned char sensor);
+
+/**
+ * \brief Start the sampling of the next proximity or ground sensor during IR communication (alternating them);
+ * the pulse is turned on only for the active phase. The sample is then taken in place of a motor sample.
+ * \param proxAllowed 1 if a proximity sensor can be sampled now (the transmission pulse is off), 0 to sample only the ground
+ * \return none
+ */
+void irCommInterleavePulse(unsigned char proxAllowed);
+
+/**
+ * \brief Move the next proximity sample taken during IR transmission to a sensor not used by the transmission
+ * (not in "irCommTxPattern").
+ * \return 1 if such a sensor exists, 0 otherwise
+ */
+unsigned char irCommInterleaveProxFree();
+
+/**
+ * \brief Turn off the IR pulse of the sensor sampled during IR communication.
+ * \return none
+ */
+void irCommInterleavePulseOff();
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,126 @@
+
+#include "blackBox.h"
+#include "utility.h"
+
+unsigned int blackBoxReadSeq(unsigned char slot) {
+	return eeprom_read_word((uint16_t*)(BLACKBOX_START_ADDR + slot*BLACKBOX_RECORD_SIZE));
+}
+
+unsigned int blackBoxNextSeq(unsigned int seq) {
+	seq++;
+	if(seq == BLACKBOX_EMPTY) {		// value of an erased eeprom
+		seq = 0;
+	}
+	return seq;
+}
+
+void blackBoxInit() {
+	unsigned char i = 0;
+	unsigned int seq = 0, prevSeq = 0;
+
+	blackBoxHead = 0;
+	blackBoxCount = 0;
+	blackBoxSeq = 0;
+
+	prevSeq = blackBoxReadSeq(0);
+	if(prevSeq == BLACKBOX_EMPTY) {
+		return;
+	}
+	for(i=1; i<BLACKBOX_RECORDS; i++) {		// the records are written in sequence, the first break is the head
+		seq = blackBoxReadSeq(i);
+		if(seq != blackBoxNextSeq(prevSeq)) {
+			break;
+		}
+		prevSeq = seq;
+	}
+	blackBoxSeq = blackBoxNextSeq(prevSeq);
+	if(i < BLACKBOX_RECORDS) {
+		blackBoxHead = i;
+		blackBoxCount = i;
+		if(blackBoxReadSeq(BLACKBOX_RECORDS-1) != BLACKBOX_EMPTY) {		// area already filled once
+			blackBoxCount = BLACKBOX_RECORDS;
+		}
+	} else {
+		blackBoxCount = BLACKBOX_RECORDS;
+	}
+}
+
+void blackBoxLog(unsigned char type, unsigned char arg, unsigned int data) {
+	unsigned char *rec;
+	unsigned int seconds = ticksToMsec(getTime100MicroSec())/1000;
+
+	if(blackBoxQueueNum >= BLACKBOX_QUEUE_SIZE) {
+		return;
+	}
+	rec = blackBoxQueue[(blackBoxQueueTail+blackBoxQueueNum)%BLACKBOX_QUEUE_SIZE];
+	rec[0] = blackBoxSeq&0xFF;
+	rec[1] = blackBoxSeq>>8;
+	rec[2] = type;
+	rec[3] = arg;
+	rec[4] = data&0xFF;
+	rec[5] = data>>8;
+	rec[6] = seconds&0xFF;
+	rec[7] = seconds>>8;
+	blackBoxSeq = blackBoxNextSeq(blackBoxSeq);
+	blackBoxQueueNum++;
+}
+
+// write the next byte of the oldest queued record; the sequence number (bytes 0 and 1) is written last
+void blackBoxWriteByte() {
+	unsigned char *rec = blackBoxQueue[blackBoxQueueTail];
+	unsigned char pos = (blackBoxByteIndex+2)%BLACKBOX_RECORD_SIZE;
+
+	eeprom_write_byte((uint8_t*)(BLACKBOX_START_ADDR + blackBoxHead*BLACKBOX_RECORD_SIZE + pos), rec[pos]);
+	blackBoxByteIndex++;
+	if(blackBoxByteIndex < BLACKBOX_RECORD_SIZE) {
+		return;
+	}
+	blackBoxByteIndex = 0;
+	blackBoxHead++;
+	if(blackBoxHead >= BLACKBOX_RECORDS) {
+		blackBoxHead = 0;
+	}
+	if(blackBoxCount < BLACKBOX_RECORDS) {
+		blackBoxCount++;
+	}
+	blackBoxQueueTail = (blackBoxQueueTail+1)%BLACKBOX_QUEUE_SIZE;
+	blackBoxQueueNum--;
+}
+
+void blackBoxTask() {
+
+	if(cliffDetectedFlag && !blackBoxCliffPrev) {
+		if((blackBoxCliffTime==0) || ((getTime100MicroSec()-blackBoxCliffTime) >= BLACKBOX_CLIFF_MIN_PERIOD)) {
+			blackBoxCliffTime = getTime100MicroSec();
+			blackBoxLog(BLACKBOX_CLIFF, 0, 0);
+		}
+	}
+	blackBoxCliffPrev = cliffDetectedFlag;
+
+	if(blackBoxQueueNum>0 && eeprom_is_ready()) {
+		blackBoxWriteByte();
+	}
+}
+
+void blackBoxFlush() {
+	while(blackBoxQueueNum > 0) {
+		blackBoxWriteByte();		// eeprom_write_byte waits for the previous write to finish
+	}
+}
+
+unsigned char blackBoxRead(unsigned char index, unsigned int *record) {
+	unsigned char slot = 0;
+	unsigned int addr = 0;
+
+	if(index >= blackBoxCount) {
+		return 0;
+	}
+	slot = (blackBoxHead + BLACKBOX_RECORDS - 1 - index)%BLACKBOX_RECORDS;
+	addr = BLACKBOX_START_ADDR + slot*BLACKBOX_RECORD_SIZE;
+	record[0] = eeprom_read_word((uint16_t*)addr);
+	record[1] = eeprom_read_byte((uint8_t*)(addr+2));
+	record[2] = eeprom_read_byte((uint8_t*)(addr+3));
+	record[3] = eeprom_read_word((uint16_t*)(addr+4));
+	record[4] = eeprom_read_word((uint16_t*)(addr+6));
+	return 1;
+}
@@ -0,0 +1,73 @@
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+
+/**
+ * \file blackBox.h
+ * \brief Persistent events log
+ * \author Stefano Morgani <stefano@gctronic.com>
+ * \version 1.0
+ * \date 19.10.26
+ * \copyright GNU GPL v3
+
+ The module keeps the last BLACKBOX_RECORDS significant events (asserts, cliff detections, brown-outs,
+ calibrations, bytecode saves) in eeprom, so that they are available after a fault or a reset.
+ The records are appended in a circular area, thus each location is written only once every
+ BLACKBOX_RECORDS events (wear leveling); the position of the next record is found at startup looking
+ for the break in the sequence numbers. The events are queued in RAM and written one byte at a time
+ from the main loop when the eeprom is ready, thus logging doesn't block the robot.
+
+ Record (8 bytes): sequence number (16 bits), type, argument, data (16 bits), time since startup (seconds, 16 bits).
+ The sequence number is written last, so a record interrupted by a reset is simply overwritten.
+*/
+
+
+#include <avr\eeprom.h>
+#include "variables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Find the position of the next record in eeprom; to be called once at startup.
+ * \return none
+ */
+void blackBoxInit();
+
+/**
+ * \brief Queue an event to be saved in eeprom; if the queue is full the event is lost.
+ * \param type event type (BLACKBOX_ASSERT, BLACKBOX_CLIFF, ...)
+ * \param arg argument of the event (e.g. assert reason)
+ * \param data additional data of the event
+ * \return none
+ */
+void blackBoxLog(unsigned char type, unsigned char arg, unsigned int data);
+
+/**
+ * \brief Write the queued events in eeprom (one byte each call when the eeprom is ready) and log the
+ * cliff detections (at most one every BLACKBOX_CLIFF_MIN_PERIOD); to be called in the main loop.
+ * \return none
+ */
+void blackBoxTask();
+
+/**
+ * \brief Write immediately all the queued events (blocking); used before stopping or resetting the robot.
+ * \return none
+ */
+void blackBoxFlush();
+
+/**
+ * \brief Read a record from eeprom.
+ * \param index 0 = last event saved, 1 = previous one, ...
+ * \param record destination of the record fields: sequence, type, argument, data, time
+ * \retval 1 record read
+ * \retval 0 no record saved with this index
+ */
+unsigned char blackBoxRead(unsigned char index, unsigned int *record);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
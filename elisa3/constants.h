@@ -9,6 +9,15 @@
 #define RAD_2_DEG 57.2957796				// conversion factor from radiant to degrees; 
 #endif										// use: degrees_value = radiant_value * RAD_2_DEG
 
+#ifndef Q12_PI								// fixed-point angles: radians in Q12 format (1 rad = 4096)
+#define Q12_PI 12868
+#define Q12_HALF_PI 6434
+#endif
+
+#ifndef CORDIC_ITERATIONS
+#define CORDIC_ITERATIONS 13				// number of CORDIC iterations used in "atan2Q12" (resolution of 1/4096 rad)
+#endif
+
 #ifndef CALIBRATION_CYCLES
 #define CALIBRATION_CYCLES 16				// number of samples used for calibration
 #endif
@@ -54,6 +63,46 @@
 #ifndef PAYLOAD_SIZE
 #define PAYLOAD_SIZE 13						// payload of the packet received from the computer
 #endif
+#define ACK_PAYLOAD_SIZE 32					// maximum payload of the ack sent back to the computer
+#define RF_ACK_FIRST_PACKET 3				// packets sent back: 3 = prox, 4 = prox4, ground, acc x-y, 5 = ambient, 6 = ambient 4, ground ambient, acc z, battery, 7 = odometry
+#define RF_ACK_PACKETS_NUM 5
+#define RF_ACK_SCHEDULE_SIZE 8				// maximum number of slots of the schedule
+#define RF_ACK_SCHEDULE_CMD 0xE0			// first byte of the command to set the schedule: 0xE0, number of slots (0 = default), packet id of each slot
+#define RF_POLL_CMD 0xE1					// first byte of a packet that only gets the next packet of the schedule, no command is executed
+
+// Aseba messages transport through the radio
+#define RF_ASEBA_FRAME 0xF0					// first byte of an Aseba frame (the first byte of a command, that is the red led, is at most 100)
+#define RF_ASEBA_FLAG_DATA 0x01				// the frame contains a new fragment
+#define RF_ASEBA_FLAG_RESET 0x02			// restart the link (sequence numbers and buffers)
+#define RF_ASEBA_HEADER_SIZE 4				// frame, sequence, ack, length
+#define RF_ASEBA_DOWN_DATA (PAYLOAD_SIZE-RF_ASEBA_HEADER_SIZE)		// fragment size from the computer to the robot
+#define RF_ASEBA_UP_DATA (ACK_PAYLOAD_SIZE-RF_ASEBA_HEADER_SIZE)	// fragment size from the robot to the computer
+#define RF_ASEBA_BUFF_SIZE 256				// must be a power of 2
+#define RF_ASEBA_RX_BUFF_SIZE 1024			// must be a power of 2 and hold a whole Aseba message (ASEBA_MAX_INNER_PACKET_SIZE + length and source)
+#define RF_ASEBA_LINK_TIMEOUT PAUSE_2_SEC	// the link is considered lost if no frame is received within this time
+#define RF_POLL_PERIOD 4					// the radio status is read in background every RF_POLL_PERIOD adc interrupts (about 400 us)
+
+// commands broadcast to all the robots (pipe1, fixed payload size, without ack)
+#define RF_BROADCAST_PIPE 1
+#define RF_BROADCAST_ADDR0 0xC2				// broadcast address (3 bytes); all ones (or zeros) would be mistaken for the preamble
+#define RF_BROADCAST_ADDR1 0xC2
+#define RF_BROADCAST_ADDR2 0xC2
+#define RF_GROUP_CMD 0xD0					// first byte of a broadcast command: 0xD0, group, type, sequence, delay (4 bytes), index, value (2 bytes)
+#define RF_GROUP_ALL 0						// command addressed to all the robots
+#define RF_GROUP_EVENT 0					// raise the "radio" event with the command value
+#define RF_GROUP_SET_VAR 1					// set "radio.var[index]" to the command value (and raise the "radio" event)
+#define RF_GROUP_VARS 4						// number of variables that can be set with a broadcast command
+#define RF_GROUP_AT_TIME 0x80				// type flag: the delay field is the absolute global time of execution (see the time beacons)
+
+// time synchronization: beacons broadcast by the computer with its time, used to estimate offset and drift of the robot clock
+#define RF_TIME_BEACON 0xD1					// first byte of a time beacon: 0xD1, time of the computer (4 bytes, 104 us units)
+#define RF_TIME_MIN_INTERVAL PAUSE_500_MSEC	// minimum and maximum time between two beacons to update the drift
+#define RF_TIME_MAX_INTERVAL PAUSE_30_SEC
+#define RF_TIME_MAX_ELAPSED 5769000			// the drift correction is limited to 10 minutes after the last beacon (avoid overflows)
+#define RF_TIME_SYNC_TIMEOUT PAUSE_10_SEC	// the time is considered synchronized if a beacon was received within this time
+#define RF_TIME_NOT_SYNC 0					// time synchronization states
+#define RF_TIME_OFFSET_SYNC 1				// only the offset is known (one beacon received)
+#define RF_TIME_DRIFT_SYNC 2				// offset and drift known
 
 /************************/
 /*** SPEED CONTROLLER ***/
@@ -142,6 +191,28 @@
 #define USE_NO_ACCEL 2						// for easier code comprehension
 #endif
 
+#ifndef I2C_CLOCK_STANDARD
+#define I2C_CLOCK_STANDARD 100000			// I2C standard mode clock (Hz), supported by all the accelerometers
+#endif
+
+#ifndef I2C_CLOCK_FAST
+#define I2C_CLOCK_FAST 400000				// I2C fast mode clock (Hz), supported by both MMA7455L and ADXL345
+#endif
+
+#ifndef ACCEL_CLOCK_PROBE_READS
+#define ACCEL_CLOCK_PROBE_READS 8			// number of consecutive correct identification reads needed to keep the fast mode
+#endif
+
+#ifndef MMA7455L_WHOAMI_REG
+#define MMA7455L_WHOAMI_REG 0x0F			// MMA7455L "who am I" register and its expected content
+#define MMA7455L_WHOAMI_VALUE 0x55
+#endif
+
+#ifndef ADXL345_DEVID_REG
+#define ADXL345_DEVID_REG 0x00				// ADXL345 device id register and its expected content
+#define ADXL345_DEVID_VALUE 0xE5
+#endif
+
 /*********************/
 /*** HARDWARE DEFS ***/
 /*********************/
@@ -296,6 +367,10 @@
 #define SAVE_TO_PROX_IRCOMM 6
 #endif
 
+#ifndef SAVE_TO_INTERLEAVED_IRCOMM
+#define SAVE_TO_INTERLEAVED_IRCOMM 7		// current sample is a ground/proximity sensor sampled in place of a motor during IR communication
+#endif
+
 /***************/
 /*** SENSORS ***/
 /***************/
@@ -369,6 +444,9 @@
 #define CALIBRATION_SAMPLES 9
 #define CALIB_CHECK_ADDRESS 3946
 #define CALIB_DATA_START_ADDR 3948
+#define SENS_CALIB_CHECK_ADDRESS 3900		// sensors (proximity, ground, accelerometer) calibration saved in eeprom
+#define SENS_CALIB_DATA_START_ADDR 3902		// offsets (12 prox/ground + 2 accelerometer) followed by the calibration counter
+#define SENS_CALIB_CHECK_VALUE 0xA55A
 
 #define CALIBRATION_STATE_SET_SPEED 0
 #define CALIBRATION_STATE_START_MEASURE 1
@@ -380,6 +458,35 @@
 #define CALIBRATION_STATE_FIND_THRS_1 7
 #define CALIBRATION_STATE_FIND_THRS_2 8
 
+// heading fusion (wheels + accelerometer)
+#ifndef HEADING_ACC_MAG_LOW
+#define HEADING_ACC_MAG_LOW 20				// gravity projected on the X-Y plane (|X|+|Y|) under which the accelerometer heading 
+#endif										// isn't trusted at all (robot flat)
+#ifndef HEADING_ACC_MAG_HIGH
+#define HEADING_ACC_MAG_HIGH 60				// gravity projected on the X-Y plane over which the accelerometer heading is fully trusted
+#endif										// (robot on a vertical wall)
+#ifndef HEADING_FUSION_GAIN
+#define HEADING_FUSION_GAIN 64				// weight (Q8, 256 = 1) of the accelerometer heading correction at each odometry step
+#endif										// when the confidence is 100%
+
+// sensors calibration states (proximity, ground and accelerometer)
+#define SENS_CALIB_STATE_IDLE 0
+#define SENS_CALIB_STATE_ACC_SETTLE 1
+#define SENS_CALIB_STATE_ACC_FLAT 2
+#define SENS_CALIB_STATE_ACC_SPIN 3
+#define SENS_CALIB_STATE_PROX 4
+#define SENS_CALIB_NEXT_NONE 0				// what to do when the sensors calibration finishes
+#define SENS_CALIB_NEXT_RESET_ODOM 1
+#define SENS_CALIB_NEXT_ODOM_CALIB 2
+
+// proximity baseline tracking (ambient light drift compensation)
+#ifndef PROX_BASELINE_WINDOW
+#define PROX_BASELINE_WINDOW 20				// the baseline is updated only when the raw proximity is lower than baseline+window 
+#endif										// (no obstacle in front of the sensor)
+#ifndef PROX_BASELINE_SHIFT
+#define PROX_BASELINE_SHIFT 8				// exponential moving average weight (1/2^shift) of each new sample
+#endif
+
 
 
 /***************/
@@ -391,6 +498,8 @@
 //#define IRCOMM_MODE_RECEIVE_ONLY 3
 //#define IRCOMM_MODE_TRANSMIT_ONLY 4
 #define IRCOMM_SAMPLING_WINDOW 20
+#define IRCOMM_CODE_FREQUENCY 0				// line code: "0" and "1" encoded with different frequencies, one bit per sampling window
+#define IRCOMM_CODE_MANCHESTER 1			// line code: Manchester, two bits per sampling window (same start bits)
 
 
 // reception
@@ -426,14 +535,98 @@
 #define IRCOMM_BIT_START2_DURATION 240
 #define IRCOMM_BIT0_DURATION 30	// based on adc isr of 104 us
 #define IRCOMM_BIT1_DURATOIN 60 // based on adc isr of 104 us
-
-// debug
-#define DEBUG_MAX_SENSOR_STATE 0
-#define DEBUG_ALL_SENSORS 0
+#define IRCOMM_BIT_MANCHESTER_BLOCK 4		// all the data and crc bits sent as one block in Manchester mode
+#define IRCOMM_MANCHESTER_HALF_DURATION 60	// half bit, that is 5 samples of the sampling window (adc isr of 104 us)
+#define IRCOMM_MANCHESTER_HALF_BITS 20		// 8 bits data + 2 bits crc, each made of two halves
+#define IRCOMM_MANCHESTER_THR 200			// minimum difference between the sum of the samples of the two halves of a bit
+#define IRCOMM_GOERTZEL_COEFF_BIT0 10126	// 2*cos(2*pi*k/N) in Q14 format, N=20 samples, k=4 cycles in the window ("0")
+#define IRCOMM_GOERTZEL_COEFF_BIT1 26509	// 2*cos(2*pi*k/N) in Q14 format, N=20 samples, k=2 cycles in the window ("1")
+#define IRCOMM_GOERTZEL_MIN_CONF 30			// minimum confidence (0..100) for a bit to be accepted
+
+// range and bearing
+#define IRCOMM_DISTANCE_POINTS 6			// number of points of the amplitude to distance curve
+#define IRCOMM_MAX_NEIGHBOURS 4				// number of neighbours tracked
+#define IRCOMM_NEIGHBOUR_TIMEOUT PAUSE_5_SEC	// a neighbour is removed when nothing is received from it for this time
+
+// channel access
+#define IRCOMM_CARRIER_SENSE_TIME PAUSE_100_MSEC	// the channel is considered busy if a signal was perceived within this time
+#define IRCOMM_BACKOFF_SLOT 480				// backoff slot, about two sampling windows (adc isr of 104 us)
+#define IRCOMM_BACKOFF_MAX_EXP 5			// maximum backoff exponent (the backoff is random between 0 and slot*2^exp)
+
+// ground and proximity sensors sampling during IR communication (one sensor sample instead of one motor sample)
+#define IRCOMM_INTERLEAVE_IDLE 0
+#define IRCOMM_INTERLEAVE_PULSE_ON 1		// IR pulse turned on (active phase only)
+#define IRCOMM_INTERLEAVE_CHANNEL_SELECTED 2	// sensor channel selected, the conversion starts at next interrupt
+#define IRCOMM_INTERLEAVE_SAMPLING 3		// sensor being converted, turn off the pulse
+#define IRCOMM_INTERLEAVE_TX_PERIOD 4		// during transmission a sensor sample is taken every 4 motor samples pairs
+#define IRCOMM_INTERLEAVE_TX_MARGIN 3		// a proximity is sampled during transmission only if the IR pulse stays off for more than 3 slots
+
+// packets
+#define IRCOMM_QUEUE_SIZE 32				// size of the tx and rx queues (bytes), must be a power of 2
+#define IRCOMM_PKT_START 0xA5				// first byte of each packet (this value cannot be sent as single byte)
+#define IRCOMM_PKT_MAX_PAYLOAD 8
+#define IRCOMM_PKT_TIMEOUT PAUSE_2_SEC		// maximum pause between two bytes of the same packet
+#define IRCOMM_PKT_WAIT_START 0				// packet parser states
+#define IRCOMM_PKT_LEN 1
+#define IRCOMM_PKT_SRC 2
+#define IRCOMM_PKT_SEQ 3
+#define IRCOMM_PKT_PAYLOAD 4
+#define IRCOMM_PKT_CRC 5
+
+// debug: capture of the IR reception through uart0 (see the capture format in irCommunication.h)
+#define DEBUG_MAX_SENSOR_STATE 0			// capture the window in which a signal is detected
+#define DEBUG_ALL_SENSORS 0					// capture all the sensors instead of only the selected one (about 60 ms to send at 57600 baud)
 #define DEBUG_MAX_SENSOR 0
-#define DEBUG_START_BIT_STATE 0
-#define DEBUG_READ_BIT 0
-#define DEBUG_BYTE_RECEPTION 0
+#define DEBUG_START_BIT_STATE 0				// capture the window of the start bit
+#define DEBUG_READ_BIT 0					// capture the windows of the data bits
+#define DEBUG_BYTE_RECEPTION 0				// capture the result of each byte reception
 #define DEBUG_BYTE_SEQUENCE 0
+#define IRCOMM_CAPTURE_SYNC0 0xFF			// capture records start
+#define IRCOMM_CAPTURE_SYNC1 0x5A
+#define IRCOMM_CAPTURE_VERSION 1
+#define IRCOMM_CAPTURE_DETECTION 0			// capture records types
+#define IRCOMM_CAPTURE_START_BIT 1
+#define IRCOMM_CAPTURE_BIT 2
+#define IRCOMM_CAPTURE_BYTE 3
+
+/**************/
+/*** LOGGER ***/
+/**************/
+#define LOG_BUFF_WORDS 256					// ring buffer size (samples of all the channels), 512 bytes
+#define LOG_MAX_CHANNELS 4
+#define LOG_CHANNELS_NUM 43					// number of signals that can be recorded (see logger.h)
+#define LOG_IDLE 0							// logger states
+#define LOG_WAIT_TRIGGER 1
+#define LOG_TRIGGERED 2
+#define LOG_DONE 3
+#define LOG_DUMP_WORDS 30					// maximum samples sent in each message of the dump
+
+/*****************/
+/*** BLACK BOX ***/
+/*****************/
+#define BLACKBOX_START_ADDR 3072			// eeprom area of the events log (after the bytecode, before the calibration data)
+#define BLACKBOX_RECORD_SIZE 8
+#define BLACKBOX_RECORDS 64					// 512 bytes
+#define BLACKBOX_QUEUE_SIZE 4				// events waiting to be written in eeprom
+#define BLACKBOX_EMPTY 0xFFFF				// sequence number of a location never written
+#define BLACKBOX_CLIFF_MIN_PERIOD PAUSE_10_SEC	// at most one cliff detection logged in this period
+#define BLACKBOX_ASSERT 1					// events types
+#define BLACKBOX_CLIFF 2
+#define BLACKBOX_BROWN_OUT 3
+#define BLACKBOX_CALIBRATION 4
+#define BLACKBOX_BYTECODE 5
+
+/***********************/
+/*** ASSERT RECOVERY ***/
+/***********************/
+#define ASSERT_MAGIC 0xA55E					// the assert information in RAM are valid (they survive the watchdog reset)
+#define ASSERT_NONE 0xFF					// no assert before the last reset
+#define ASSERT_MAX_CONSECUTIVE 3			// the bytecode isn't loaded at startup after this number of consecutive asserts
+#define ASSERT_CLEAR_TIME PAUSE_30_SEC		// running time without asserts after which the consecutive asserts counter is cleared
+
+/************/
+/*** IDLE ***/
+/************/
+#define IDLE_MEASURE_PERIOD PAUSE_1_SEC		// adc interrupts used to measure the idle fraction
 
 
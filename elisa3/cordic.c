@@ -0,0 +1,60 @@
+
+#include "cordic.h"
+
+// atan(2^-i) in radians, Q12 format
+static const signed int cordicAtanTable[CORDIC_ITERATIONS] = {3217, 1899, 1003, 509, 256, 128, 64, 32, 16, 8, 4, 2, 1};
+
+signed int atan2Q12(signed int y, signed int x) {
+
+	signed long int xi = x, yi = y, tmp = 0;
+	signed int angle = 0;
+	unsigned char i = 0;
+
+	if(x==0 && y==0) {
+		return 0;
+	}
+
+	// the CORDIC converges only in the right half plane, thus rotate the vector by +-90 degrees when needed
+	if(xi < 0) {
+		if(yi >= 0) {		// rotate by -90 degrees
+			tmp = xi;
+			xi = yi;
+			yi = -tmp;
+			angle = Q12_HALF_PI;
+		} else {			// rotate by +90 degrees
+			tmp = xi;
+			xi = -yi;
+			yi = tmp;
+			angle = -Q12_HALF_PI;
+		}
+	}
+
+	xi = xi<<12;			// more resolution for the last iterations (no overflow in the whole 16 bits input range)
+	yi = yi<<12;
+
+	// rotate the vector towards the x axis, accumulating the rotation angle
+	for(i=0; i<CORDIC_ITERATIONS; i++) {
+		if(yi > 0) {
+			tmp = xi + (yi>>i);
+			yi = yi - (xi>>i);
+			xi = tmp;
+			angle += cordicAtanTable[i];
+		} else {
+			tmp = xi - (yi>>i);
+			yi = yi + (xi>>i);
+			xi = tmp;
+			angle -= cordicAtanTable[i];
+		}
+	}
+
+	return angle;
+
+}
+
+signed int radQ12ToDeg(signed int angle) {
+	if(angle >= 0) {
+		return (signed int)(((signed long int)angle*180 + Q12_HALF_PI)/Q12_PI);
+	} else {
+		return (signed int)(((signed long int)angle*180 - Q12_HALF_PI)/Q12_PI);
+	}
+}
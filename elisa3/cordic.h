@@ -0,0 +1,45 @@
+#ifndef CORDIC_H
+#define CORDIC_H
+
+
+/**
+ * \file cordic.h
+ * \brief Fixed-point trigonometry
+ * \author Stefano Morgani <stefano@gctronic.com>
+ * \version 1.0
+ * \date 19.10.26
+ * \copyright GNU GPL v3
+
+ The module contains the fixed-point angle computations (CORDIC). The functions don't access the global
+ variables nor the microcontroller registers, thus they are also built and tested on the computer (see tests).
+*/
+
+
+#include "constants.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Fixed-point arctangent of y/x using the CORDIC algorithm in vectoring mode (same convention as
+ * the standard "atan2" function). It takes about 13 iterations of shifts and additions instead of the
+ * software floating point "atan2"; the error is below 0.05 degrees in the accelerometer range.
+ * \param y numerator
+ * \param x denominator
+ * \return the angle in radians, Q12 format (-Q12_PI..Q12_PI); 0 if both inputs are 0
+ */
+signed int atan2Q12(signed int y, signed int x);
+
+/**
+ * \brief Convert an angle from radians in Q12 format to degrees (rounded to the nearest integer).
+ * \param angle angle in radians, Q12 format
+ * \return the angle in degrees
+ */
+signed int radQ12ToDeg(signed int angle);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -5,12 +5,34 @@
 void writeCalibrationToFlash() {	
 	eeprom_update_block(calibration, (uint8_t*) CALIB_DATA_START_ADDR, 144);
 	eeprom_update_word ((uint16_t*) CALIB_CHECK_ADDRESS, 0xAA55);   // to let know the calibration data are valid
+	blackBoxLog(BLACKBOX_CALIBRATION, 1, 0);
 }
 
 void readCalibrationFromFlash() {
 	eeprom_read_block (calibration, (uint8_t*) CALIB_DATA_START_ADDR, 144);
 }
 
+void writeSensorsCalibrationToFlash() {
+	calibrationCounter++;
+	eeprom_update_block(proximityOffset, (uint8_t*) SENS_CALIB_DATA_START_ADDR, 24);
+	eeprom_update_word((uint16_t*) (SENS_CALIB_DATA_START_ADDR+24), (uint16_t)accOffsetX);
+	eeprom_update_word((uint16_t*) (SENS_CALIB_DATA_START_ADDR+26), (uint16_t)accOffsetY);
+	eeprom_update_word((uint16_t*) (SENS_CALIB_DATA_START_ADDR+28), calibrationCounter);
+	eeprom_update_word((uint16_t*) SENS_CALIB_CHECK_ADDRESS, SENS_CALIB_CHECK_VALUE);	// to let know the calibration data are valid
+	blackBoxLog(BLACKBOX_CALIBRATION, 0, calibrationCounter);
+}
+
+unsigned char readSensorsCalibrationFromFlash() {
+	if(eeprom_read_word((uint16_t*) SENS_CALIB_CHECK_ADDRESS) != SENS_CALIB_CHECK_VALUE) {
+		return 0;
+	}
+	eeprom_read_block(proximityOffset, (uint8_t*) SENS_CALIB_DATA_START_ADDR, 24);
+	accOffsetX = (signed int)eeprom_read_word((uint16_t*) (SENS_CALIB_DATA_START_ADDR+24));
+	accOffsetY = (signed int)eeprom_read_word((uint16_t*) (SENS_CALIB_DATA_START_ADDR+26));
+	calibrationCounter = eeprom_read_word((uint16_t*) (SENS_CALIB_DATA_START_ADDR+28));
+	return 1;
+}
+
 
 
 
@@ -4,6 +4,7 @@
 
 #include <avr\eeprom.h>
 #include "variables.h"
+#include "blackBox.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,6 +13,20 @@ extern "C" {
 void writeCalibrationToFlash();
 void readCalibrationFromFlash();
 
+/**
+ * \brief Save the sensors calibration (proximity, ground and accelerometer offsets) in eeprom together
+ * with a progressive counter incremented at each save.
+ * \return none
+ */
+void writeSensorsCalibrationToFlash();
+
+/**
+ * \brief Load the sensors calibration previously saved in eeprom.
+ * \retval 1 valid calibration found and loaded
+ * \retval 0 no calibration saved in eeprom, the offsets are left untouched
+ */
+unsigned char readSensorsCalibrationFromFlash();
+
 
 #ifdef __cplusplus
 } // extern "C"
@@ -32,9 +32,15 @@
 #include <transport/buffer/vm-buffer.h>
 #include "elisa_natives.h"
 #include "variables.h"
+#include "rfAseba.h"
+#include "logger.h"
 
 #define argsSize 32
 
+#define STREAM_RANGES 2			// variables ranges streamed to the computer
+#define STREAM_MAX_WORDS 64		// maximum number of variables streamed (sum of the ranges)
+#define STREAM_MERGE_GAP 3		// unchanged variables between two changed ones sent anyway (cheaper than a new message)
+
 #define CLAMP(v, vmin, vmax) ((v) < (vmin) ? (vmin) : (v) > (vmax) ? (vmax) : (v))
 
 #define LEFT 0
@@ -110,7 +116,20 @@ struct Elisa3Variables
 	// local communication
 	sint16 irRxData;
 	sint16 irRxId;
+	sint16 irRxConf;
+	sint16 irRxStrength[8];
+	sint16 irRxBearing;
+	sint16 irRxDist;
+	sint16 neighbourId[IRCOMM_MAX_NEIGHBOURS];
+	sint16 neighbourBearing[IRCOMM_MAX_NEIGHBOURS];
+	sint16 neighbourDist[IRCOMM_MAX_NEIGHBOURS];
+	sint16 irTxCount;
+	sint16 irTxDeferred;
+	sint16 irRxErrors;
 	sint16 irTxData;
+	sint16 irRxPkt[IRCOMM_PKT_MAX_PAYLOAD];
+	sint16 irRxPktLen;
+	sint16 irRxPktSrc;
 
 //	// Charge state (0 => robot not in charge; 1 => robot in charge).
 //	// Only meaningful if radio communication is used (when cable attached the state is always in charge).
@@ -120,6 +139,36 @@ struct Elisa3Variables
 	sint16 thetaDeg;
 	sint16 xPosMm;
 	sint16 yPosMm;
+	sint16 thetaConf;
+
+	// proximity offsets following the ambient light
+	sint16 proxBaseline[8];
+
+	// commands broadcast through the radio
+	sint16 radioGroup;
+	sint16 radioCmd;
+	sint16 radioVar[RF_GROUP_VARS];
+
+	// global time (ms, synchronized through the radio): low word, high word
+	sint16 timeSync;
+	sint16 timeGlobal[2];
+	sint16 timeEvent[2];
+
+	// variables streaming: only the variables changed are sent to the computer every period (ms)
+	sint16 streamStart[STREAM_RANGES];
+	sint16 streamLen[STREAM_RANGES];
+	sint16 streamPeriod;
+
+	// high rate logger: state and frames recorded
+	sint16 logState;
+	sint16 logFrames;
+
+	// assert before the last reset (-1 = none) and consecutive asserts (bytecode not loaded when too many)
+	sint16 assertReason;
+	sint16 assertCount;
+
+	// time spent in idle mode during the last second (percentage)
+	sint16 cpuIdle;
 
 	// timer
 	sint16 timer;
@@ -158,10 +207,39 @@ AsebaVMDescription vmDescription = {
 		{1, "bat.percent"},
 		{1, "prox.comm.rx"},
 		{1, "prox.comm.rx.id"},	
+		{1, "prox.comm.rx.conf"},
+		{8, "prox.comm.rx.strength"},
+		{1, "prox.comm.rx.bearing"},
+		{1, "prox.comm.rx.dist"},
+		{IRCOMM_MAX_NEIGHBOURS, "neighbours.id"},
+		{IRCOMM_MAX_NEIGHBOURS, "neighbours.bearing"},
+		{IRCOMM_MAX_NEIGHBOURS, "neighbours.dist"},
+		{1, "prox.comm.tx.count"},
+		{1, "prox.comm.tx.deferred"},
+		{1, "prox.comm.rx.errors"},
 		{1, "prox.comm.tx"},
+		{IRCOMM_PKT_MAX_PAYLOAD, "prox.comm.pkt.rx"},
+		{1, "prox.comm.pkt.len"},
+		{1, "prox.comm.pkt.src"},
 		{1, "odom.theta"},
 		{1, "odom.x"},
 		{1, "odom.y"},
+		{1, "odom.theta.conf"},
+		{8, "prox.baseline"},
+		{1, "radio.group"},
+		{1, "radio.cmd"},
+		{RF_GROUP_VARS, "radio.var"},
+		{1, "time.sync"},
+		{2, "time.global"},
+		{2, "time.event"},
+		{STREAM_RANGES, "stream.start"},
+		{STREAM_RANGES, "stream.len"},
+		{1, "stream.period"},
+		{1, "log.state"},
+		{1, "log.frames"},
+		{1, "assert.reason"},
+		{1, "assert.count"},
+		{1, "cpu.idle"},
 //		{1, "charge"},
 		{1, "timer.period"},
 		{ 0, NULL }				// null terminated
@@ -200,6 +278,11 @@ enum Events
 	EVENT_RC5,
 	EVENT_SELECTOR,
 	EVENT_TIMER,
+	EVENT_CALIB,
+	EVENT_PKT,
+	EVENT_NEIGHBOUR,
+	EVENT_RADIO,
+	EVENT_LOG,
 //	EVENT_CHARGE,
 	EVENTS_COUNT
 };
@@ -213,6 +296,11 @@ static const AsebaLocalEventDescription localEvents[] = {
 	{"sel", "Selector status changed"},
 //	{"charge", "Charge status changed"},
 	{"timer", "Timer"},
+	{"calib", "Sensors calibration finished"},
+	{"prox.comm.pkt", "Packet received on local communication"},
+	{"neighbour", "Neighbour range and bearing updated"},
+	{"radio", "Command broadcast through the radio executed"},
+	{"log", "Logger buffer filled"},
 	{ NULL, NULL }
 };
 
@@ -264,7 +352,17 @@ void AsebaSendBuffer(AsebaVMState *vm, const uint8* data, uint16 length)
 	uartSendUInt16(vmState.nodeId);
 	uint16 i;
 	for (i = 0; i < length; i++)
-		uartSendUInt8(*data++);
+		uartSendUInt8(data[i]);
+
+	// the same stream is sent also through the radio when a computer is connected
+	if(rfAsebaIsConnected()) {
+		rfAsebaSendByte((length - 2)&0xFF);
+		rfAsebaSendByte((length - 2)>>8);
+		rfAsebaSendByte(vmState.nodeId&0xFF);
+		rfAsebaSendByte(vmState.nodeId>>8);
+		for (i = 0; i < length; i++)
+			rfAsebaSendByte(data[i]);
+	}
 }	
 
 uint8 uartGetUInt8()
@@ -315,6 +413,13 @@ uint16 uartGetUInt16()
 
 uint16 AsebaGetBuffer(AsebaVMState *vm, uint8* data, uint16 maxLength, uint16* source)
 {
+	unsigned int rfSource = 0;
+	uint16 rfLen = rfAsebaGetMessage(data, maxLength, &rfSource);	// messages reassembled from the radio
+	if(rfLen > 0) {
+		*source = rfSource;
+		return rfLen;
+	}
+
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {	// Handle concurrent byteCount access
 		if(byteCount == 0) {			// (accessed here and within ISR rx interrupt).
 			return 0;
@@ -346,38 +451,152 @@ uint16 AsebaGetBuffer(AsebaVMState *vm, uint8* data, uint16 maxLength, uint16* s
 	return len;
 }	
 
+static sint16 streamShadow[STREAM_MAX_WORDS];		// last values sent
+static uint8 streamBuffer[4+2*STREAM_MAX_WORDS];
+static sint16 streamConfig[2*STREAM_RANGES];
+
+void streamSendRun(uint16 start, uint16 len)
+{
+	uint16 i;
+	// same message sent in reply to a variables request, thus the computer updates the values it shows
+	streamBuffer[0] = ASEBA_MESSAGE_VARIABLES&0xFF;
+	streamBuffer[1] = ASEBA_MESSAGE_VARIABLES>>8;
+	streamBuffer[2] = start&0xFF;
+	streamBuffer[3] = start>>8;
+	for(i=0; i<len; i++) {
+		streamBuffer[4+2*i] = vmState.variables[start+i]&0xFF;
+		streamBuffer[5+2*i] = ((uint16)vmState.variables[start+i])>>8;
+	}
+	AsebaSendBuffer(&vmState, streamBuffer, 4+2*len);
+}
+
+void streamVariables()
+{
+	static uint32_t streamTick = 0;
+	uint16 r, i, offset = 0, runStart = 0, gap = 0;
+	sint16 start, len;
+	uint8 inRun = 0, reconfigured = 0;
+
+	if(elisa3Variables.streamPeriod <= 0) {
+		return;
+	}
+	if(((getTime100MicroSec()-streamTick)/10) < elisa3Variables.streamPeriod) {	// This is divided by 10 to get about 1 ms.
+		return;
+	}
+	streamTick = getTime100MicroSec();
+
+	// the ranges are changed => send all the values
+	for(r=0; r<STREAM_RANGES; r++) {
+		if((streamConfig[2*r] != elisa3Variables.streamStart[r]) || (streamConfig[2*r+1] != elisa3Variables.streamLen[r])) {
+			streamConfig[2*r] = elisa3Variables.streamStart[r];
+			streamConfig[2*r+1] = elisa3Variables.streamLen[r];
+			reconfigured = 1;
+		}
+	}
+
+	for(r=0; r<STREAM_RANGES; r++) {
+		start = elisa3Variables.streamStart[r];
+		len = elisa3Variables.streamLen[r];
+		if((start < 0) || (len <= 0) || ((uint16)(start+len) > vmState.variablesSize) || ((offset+len) > STREAM_MAX_WORDS)) {
+			continue;	// range not valid, ignored
+		}
+		// send the runs of changed variables
+		inRun = 0;
+		gap = 0;
+		for(i=0; i<len; i++) {
+			if(reconfigured || (vmState.variables[start+i] != streamShadow[offset+i])) {
+				if(inRun == 0) {
+					inRun = 1;
+					runStart = i;
+				}
+				gap = 0;
+				streamShadow[offset+i] = vmState.variables[start+i];
+			} else if(inRun) {
+				gap++;
+				if(gap > STREAM_MERGE_GAP) {
+					streamSendRun(start+runStart, i-gap+1-runStart);
+					inRun = 0;
+				}
+			}
+		}
+		if(inRun) {
+			streamSendRun(start+runStart, len-gap-runStart);
+		}
+		offset += len;
+	}
+}
+
+static uint8 logDumpBuffer[6+2*LOG_DUMP_WORDS];
+
+void logDumpTask()
+{
+	uint16 frames, num;
+
+	if(logDumpEvent < 0) {
+		return;
+	}
+	if(logDumpIndex >= logGetFrames()) {
+		logDumpEvent = -1;
+		return;
+	}
+
+	// user message (as an "emit"): first frame index, channels number, samples
+	frames = LOG_DUMP_WORDS/logNumCh;
+	num = logReadFrames(logDumpIndex, frames, (signed int*)&logDumpBuffer[6]);	// the avr is little endian as the wire, no conversion
+	logDumpBuffer[0] = logDumpEvent&0xFF;
+	logDumpBuffer[1] = logDumpEvent>>8;
+	logDumpBuffer[2] = logDumpIndex&0xFF;
+	logDumpBuffer[3] = logDumpIndex>>8;
+	logDumpBuffer[4] = logNumCh;
+	logDumpBuffer[5] = 0;
+	AsebaSendBuffer(&vmState, logDumpBuffer, 6+2*num*logNumCh);
+	logDumpIndex += num;
+}
+
 void updateRobotVariables() {
 
 	unsigned i;
+	unsigned long int globalTime = 0;
 	static int accState = 1;
 	static uint32_t batteryTick = 0;
 	static char btnState = -1;
 	static char selectorState = -1;
 //	static char chargeState = -1;
 	static uint32_t timerTick = 0;
+	static uint8 logStatePrev = LOG_IDLE;
 
 	// motor
 	static int leftSpeed = 0, rightSpeed = 0;
 
-	if (elisa3Variables.targetSpeed[LEFT] != leftSpeed) {
-		leftSpeed = CLAMP(elisa3Variables.targetSpeed[LEFT], -127, 127);
-		setLeftSpeed(leftSpeed);
-	}
-	if (elisa3Variables.targetSpeed[RIGHT] != rightSpeed) {
-		rightSpeed = CLAMP(elisa3Variables.targetSpeed[RIGHT], -127, 127);
-		setRightSpeed(rightSpeed);
+	if(calibrationState != SENS_CALIB_STATE_IDLE) {	// the calibration drives the motors, the targets are applied when it finishes
+		if(calibrateSensorsTask() == 0) {
+			setLeftSpeed(leftSpeed);
+			setRightSpeed(rightSpeed);
+			SET_EVENT(EVENT_CALIB);
+		}
+	} else {
+		if (elisa3Variables.targetSpeed[LEFT] != leftSpeed) {
+			leftSpeed = CLAMP(elisa3Variables.targetSpeed[LEFT], -127, 127);
+			setLeftSpeed(leftSpeed);
+		}
+		if (elisa3Variables.targetSpeed[RIGHT] != rightSpeed) {
+			rightSpeed = CLAMP(elisa3Variables.targetSpeed[RIGHT], -127, 127);
+			setRightSpeed(rightSpeed);
+		}
+		handleMotorsWithSpeedController();
 	}
 	elisa3Variables.measSpeed[LEFT] = speedLeftFromEnc/5;	// Divide by 5 to get the same scale as target speed (1 unit = 5 mm/s).
 	elisa3Variables.measSpeed[RIGHT] = speedRightFromEnc/5;
-	handleMotorsWithSpeedController();
 
 	if(proxUpdated) {
 		proxUpdated = 0;
+		updateProximityBaseline();
 		// leds and prox
 		for (i = 0; i < 8; i++) {
 			setGreenLed(i, elisa3Variables.greenLeds[i] ? 1 : 0);
 			elisa3Variables.proxAmbient[i] = proximityValue[i*2];
 			elisa3Variables.prox[i] =  proximityResultLinear[i];
+			elisa3Variables.proxBaseline[i] = proximityOffset[i];
 		}
 		for(i=0; i<4; i++) {
 			elisa3Variables.groundAmbient[i] = proximityValue[(i+8)*2];
@@ -401,13 +620,45 @@ void updateRobotVariables() {
 		elisa3Variables.thetaDeg = (signed int)(theta*RAD_2_DEG);
 		elisa3Variables.xPosMm = (signed int)xPos;
 		elisa3Variables.yPosMm = (signed int)yPos;
+		elisa3Variables.thetaConf = headingConfidence;
 	}
 	accState = 1 - accState;
 
-	// rgb leds
-	updateRedLed(255-CLAMP(elisa3Variables.rgbLeds[0], 0, 255));
-	updateGreenLed(255-CLAMP(elisa3Variables.rgbLeds[1], 0, 255));
-	updateBlueLed(255-CLAMP(elisa3Variables.rgbLeds[2], 0, 255));
+	// rgb leds (used to show the progress during calibration)
+	if(calibrationState == SENS_CALIB_STATE_IDLE) {
+		updateRedLed(255-CLAMP(elisa3Variables.rgbLeds[0], 0, 255));
+		updateGreenLed(255-CLAMP(elisa3Variables.rgbLeds[1], 0, 255));
+		updateBlueLed(255-CLAMP(elisa3Variables.rgbLeds[2], 0, 255));
+	}
+
+	// global time
+	globalTime = ticksToMsec(getGlobalTime());
+	elisa3Variables.timeGlobal[0] = globalTime&0xFFFF;
+	elisa3Variables.timeGlobal[1] = globalTime>>16;
+	elisa3Variables.timeSync = isGlobalTimeSynchronized();
+
+	// commands broadcast through the radio, executed at the same time by all the robots of the group
+	rfGroupId = elisa3Variables.radioGroup;
+	if(rfGroupCommandDue()) {
+		if(rfGroupCmdType == RF_GROUP_SET_VAR) {
+			if(rfGroupCmdIndex < RF_GROUP_VARS) {
+				elisa3Variables.radioVar[rfGroupCmdIndex] = rfGroupCmdValue;
+			}
+		} else {
+			elisa3Variables.radioCmd = rfGroupCmdValue;
+		}
+		SET_EVENT(EVENT_RADIO);
+	}
+
+	elisa3Variables.cpuIdle = getIdlePercent();
+
+	// logger
+	elisa3Variables.logState = logState;
+	elisa3Variables.logFrames = logGetFrames();
+	if((logStatePrev != LOG_DONE) && (logState == LOG_DONE)) {
+		SET_EVENT(EVENT_LOG);
+	}
+	logStatePrev = logState;
 
 	// selector
 	elisa3Variables.selector = getSelector();
@@ -455,14 +706,48 @@ void updateRobotVariables() {
 	
 	if(irCommEnabled != IRCOMM_MODE_SENSORS_SAMPLING) {
 		irCommTasks();
-		if(irCommDataSent()==1) {
+		if((irCommDataSent()==1) && (irCommTxQueueEmpty()==1)) {	// the byte is sent continuously when no packets are queued
 			irCommSendData((unsigned char)elisa3Variables.irTxData);
 		}
 		if(irCommDataAvailable()==1) {
 			elisa3Variables.irRxData = irCommReadData();
 			SET_EVENT(EVENT_DATA);
 			elisa3Variables.irRxId = irCommReceivingSensor();
+			elisa3Variables.irRxConf = irCommReceivedConfidence();
+			for(i=0; i<8; i++) {
+				elisa3Variables.irRxStrength[i] = irCommReceivingStrength(i);
+			}
+			elisa3Variables.irRxBearing = irCommRxBearingEstimate();
+			elisa3Variables.irRxDist = irCommRxDistanceEstimate();
+		}
+		if(irCommPacketAvailable()==1) {
+			unsigned char pkt[IRCOMM_PKT_MAX_PAYLOAD];
+			unsigned char src = 0, seq = 0;
+			signed char sensor = 0;
+			elisa3Variables.irRxPktLen = irCommReadPacket(pkt, &src, &seq, &sensor);
+			for(i=0; i<IRCOMM_PKT_MAX_PAYLOAD; i++) {
+				elisa3Variables.irRxPkt[i] = (i < elisa3Variables.irRxPktLen) ? pkt[i] : 0;
+			}
+			elisa3Variables.irRxPktSrc = src;
+			elisa3Variables.irRxId = sensor;
+			elisa3Variables.irRxConf = irCommReceivedConfidence();
+			for(i=0; i<8; i++) {
+				elisa3Variables.irRxStrength[i] = irCommReceivingStrength(i);
+			}
+			elisa3Variables.irRxBearing = irCommRxBearingEstimate();
+			elisa3Variables.irRxDist = irCommRxDistanceEstimate();
+			irCommUpdateNeighbour(src);
+			SET_EVENT(EVENT_PKT);
+			SET_EVENT(EVENT_NEIGHBOUR);
+		}
+		for(i=0; i<IRCOMM_MAX_NEIGHBOURS; i++) {
+			elisa3Variables.neighbourId[i] = irCommNeighbourId[i];
+			elisa3Variables.neighbourBearing[i] = irCommNeighbourBearing[i];
+			elisa3Variables.neighbourDist[i] = irCommNeighbourDistance[i];
 		}
+		elisa3Variables.irTxCount = irCommTxCount;
+		elisa3Variables.irTxDeferred = irCommTxDeferredCount;
+		elisa3Variables.irRxErrors = irCommRxErrorCount;
 	}
 
 	if(elisa3Variables.timer > 0) {
@@ -483,10 +768,29 @@ void updateRobotVariables() {
 
 void AsebaAssert(AsebaVMState *vm, AsebaAssertReason reason)
 {
+	cli();	// nothing else must drive the motors
+	// stop the motors immediately changing the pwm registers directly (as the cliff avoidance)
+	pwm_left = 0;
+	OCR4A = 0;
+	OCR4B = 0;
+	pwm_right = 0;
+	OCR3A = 0;
+	OCR3B = 0;
+
 	turnOnGreenLeds();
 	updateRedLed(0);
 	updateGreenLed(255);
 	updateBlueLed(255);
+	blackBoxLog(BLACKBOX_ASSERT, reason, vm->pc);
+	blackBoxFlush();
+
+	// restart through the watchdog, the reason is reported at the next startup
+	assertMagic = ASSERT_MAGIC;
+	assertReason = reason;
+	if(assertCount < 255) {
+		assertCount++;
+	}
+	wdt_enable(WDTO_15MS);
 	while (1);
 }
 
@@ -501,6 +805,7 @@ void AsebaWriteBytecode(AsebaVMState *vm) {
 
 	int i=0;
 	uint16_t* EE_addr = (uint16_t*)&bytecode_version;
+	uint16 checksum = 0;
 
 	i = ASEBA_PROTOCOL_VERSION;
 
@@ -512,8 +817,11 @@ void AsebaWriteBytecode(AsebaVMState *vm) {
 
 	for(i=0; i<VM_BYTECODE_SIZE; i++) {	
 		eeprom_write_word(EE_addr, vm->bytecode[i]);
+		checksum += vm->bytecode[i];
 		EE_addr++;
 	}
+	blackBoxLog(BLACKBOX_BYTECODE, 0, checksum);	// the checksum identifies the program saved
+	assertCount = 0;	// a new program is loaded at the next startup even after many asserts
 
 //	UCSR0A &= ~(1 << FE0) & ~(1 << DOR0) & ~(1 << UPE0); // Clear uart error flags.
 
@@ -550,14 +858,30 @@ int main()
 
 	initAseba();
 
-	calibrateSensors();
+	if(readSensorsCalibrationFromFlash() == 0) {	// no calibration saved => calibrate while running
+		calibrateSensorsStart();
+	} else {
+		resetProximityBaseline();
+	}
 	
 
+	if((assertMagic != ASSERT_MAGIC) || ((mcusrMirror & (1 << WDRF)) == 0)) {	// not restarted after an assert
+		assertMagic = ASSERT_MAGIC;
+		assertReason = ASSERT_NONE;
+		assertCount = 0;
+	}
+	if(assertReason == ASSERT_NONE) {
+		elisa3Variables.assertReason = -1;
+	} else {
+		elisa3Variables.assertReason = assertReason;
+	}
+	elisa3Variables.assertCount = assertCount;
+
 	uint16_t* EE_addr = (uint16_t*)&bytecode_version;
 	i = eeprom_read_word(EE_addr);
 
-	// ...only load bytecode if version is the same as current one
-	if(i == ASEBA_PROTOCOL_VERSION)
+	// ...only load bytecode if version is the same as current one and the program isn't failing repeatedly
+	if((i == ASEBA_PROTOCOL_VERSION) && (assertCount < ASSERT_MAX_CONSECUTIVE))
 	{
 
 		EE_addr = (uint16_t*)eeprom_bytecode;
@@ -572,19 +896,29 @@ int main()
 	}
 	
 
-	if(MCUSR & (1 << 0)) {	// if power on reset does nothing...wait for the serial connection to be opened
-		MCUSR &= ~(1<<0);	// clear flag
+	// the reset flags are saved and cleared at startup (see saveResetFlags)
+	if(mcusrMirror & (1 << BORF)) {	// brown-out reset (battery too low or disconnected for a moment)
+		blackBoxLog(BLACKBOX_BROWN_OUT, 0, mcusrMirror);
 	}
 
-	if(MCUSR & (1 << 1)) {	// external reset event (caused by the serial connection opened) => send description to aseba
-		MCUSR &= ~(1<<1);
+	if(mcusrMirror & (1 << PORF)) {	// if power on reset does nothing...wait for the serial connection to be opened
+	}
+
+	if(mcusrMirror & (1 << EXTRF)) {	// external reset event (caused by the serial connection opened) => send description to aseba
 		//AsebaSendDescription(&vmState); // Not necessary.
 	}
 
 	while (1) {
 
+		rfTasks();	// Aseba frames and commands received through the radio
 		AsebaProcessIncomingEvents(&vmState);
 		updateRobotVariables();
+		streamVariables();
+		logDumpTask();	// one message of the logger dump each loop
+		blackBoxTask();
+		if((assertCount > 0) && (getTime100MicroSec() >= ASSERT_CLEAR_TIME)) {	// the program is running fine
+			assertCount = 0;
+		}
 		AsebaVMRun(&vmState, 1000);
 
 		if (AsebaMaskIsClear(vmState.flags, ASEBA_VM_STEP_BY_STEP_MASK) || AsebaMaskIsClear(vmState.flags, ASEBA_VM_EVENT_ACTIVE_MASK))
@@ -603,11 +937,19 @@ int main()
 				i--;
 				CLEAR_EVENT(i);
 				elisa3Variables.source = vmState.nodeId;
+				elisa3Variables.timeEvent[0] = elisa3Variables.timeGlobal[0];	// event timestamp (global time)
+				elisa3Variables.timeEvent[1] = elisa3Variables.timeGlobal[1];
 				AsebaVMSetupEvent(&vmState, ASEBA_EVENT_LOCAL_EVENTS_START - i);
 			}
 
 		}
 
+		// no events to handle and the VM isn't running => wait for the next interrupt in idle mode; the
+		// adc interrupt (104 us) wakes up the cpu, thus the loop still runs often enough for the periodic tasks
+		if((events_flags == 0) && AsebaMaskIsClear(vmState.flags, ASEBA_VM_EVENT_ACTIVE_MASK) && (logDumpEvent < 0) && (blackBoxQueueNum == 0)) {
+			idleSleep();
+		}
+
 	}
 	
 	return 0;
@@ -1,10 +1,12 @@
 
 #include "elisa_natives.h"
 #include "irCommunication.h"
+#include "logger.h"
+#include "blackBox.h"
 
 AsebaNativeFunctionDescription AsebaNativeDescription_prox_network = {
 	"prox.comm.enable",
-	"Enable/disable local communication",
+	"Enable/disable local communication (0=off, 1=on, 2=on fast mode)",
 	{
 		{1, "state"},
 		{0,0},
@@ -13,13 +15,114 @@ AsebaNativeFunctionDescription AsebaNativeDescription_prox_network = {
 		
 void prox_network(AsebaVMState * vm) {
 	int enable = vm->variables[AsebaNativePopArg(vm)];
-	if(enable) {
-		irCommInit();
+	if(enable == 2) {
+		irCommInit(IRCOMM_CODE_MANCHESTER);
+	} else if(enable) {
+		irCommInit(IRCOMM_CODE_FREQUENCY);
 	} else {
 		irCommDeinit();
 	}
 }
 
+AsebaNativeFunctionDescription AsebaNativeDescription_setDiversity = {
+	"prox.comm.rx.diversity",
+	"Enable/disable the reception combining all the sensors",
+	{
+		{1, "state"},
+		{0,0},
+	}
+};
+
+void setDiversity(AsebaVMState * vm) {
+	int enable = vm->variables[AsebaNativePopArg(vm)];
+	if(enable) {
+		irCommRxDiversityEnabled = 1;
+	} else {
+		irCommRxDiversityEnabled = 0;
+	}
+}
+
+AsebaNativeFunctionDescription AsebaNativeDescription_setTxMask = {
+	"prox.comm.tx.mask",
+	"Select the sensors used to transmit (bit 0 = front sensor, clockwise)",
+	{
+		{1, "mask"},
+		{0,0},
+	}
+};
+
+void setTxMask(AsebaVMState * vm) {
+	int mask = vm->variables[AsebaNativePopArg(vm)];
+	irCommSetTxSensorMask((unsigned char)mask);
+}
+
+AsebaNativeFunctionDescription AsebaNativeDescription_setGroundInterleave = {
+	"prox.comm.ground",
+	"Enable/disable the ground sensors sampling (cliff avoidance) during local communication",
+	{
+		{1, "state"},
+		{0,0},
+	}
+};
+
+void setGroundInterleave(AsebaVMState * vm) {
+	int enable = vm->variables[AsebaNativePopArg(vm)];
+	if(enable) {
+		irCommGroundEnabled = 1;
+	} else {
+		irCommGroundEnabled = 0;
+	}
+}
+
+AsebaNativeFunctionDescription AsebaNativeDescription_setProxInterleave = {
+	"prox.comm.prox",
+	"Enable/disable the proximity sensors sampling (obstacle avoidance) during local communication",
+	{
+		{1, "state"},
+		{0,0},
+	}
+};
+
+void setProxInterleave(AsebaVMState * vm) {
+	int enable = vm->variables[AsebaNativePopArg(vm)];
+	if(enable) {
+		irCommProxEnabled = 1;
+	} else {
+		irCommProxEnabled = 0;
+	}
+}
+
+AsebaNativeFunctionDescription AsebaNativeDescription_sendPacket = {
+	"prox.comm.pkt.send",
+	"Send a packet through local communication",
+	{
+		{-1, "data"},
+		{1, "len"},
+		{0,0},
+	}
+};
+
+void sendPacket(AsebaVMState * vm) {
+	uint16 data = AsebaNativePopArg(vm);
+	int len = vm->variables[AsebaNativePopArg(vm)];
+	uint16 size = AsebaNativePopArg(vm);
+	unsigned char pkt[IRCOMM_PKT_MAX_PAYLOAD];
+	unsigned char i = 0;
+	if(len > size) {
+		len = size;
+	}
+	if(len > IRCOMM_PKT_MAX_PAYLOAD) {
+		len = IRCOMM_PKT_MAX_PAYLOAD;
+	}
+	if(len <= 0) {
+		return;
+	}
+	for(i=0; i<len; i++) {
+		pkt[i] = (unsigned char)vm->variables[data+i];
+	}
+	irCommSendPacket(pkt, len);
+}
+
 AsebaNativeFunctionDescription AsebaNativeDescription_setObstacleAvoidance = {
 	"behavior.oa.enable",
 	"Enable/disable obstacle avoidance",
@@ -56,18 +159,55 @@ void setCliffAvoidance(AsebaVMState * vm) {
 	}
 }
 
-// The "calibrateSensors()" function is blocking and thus create problems in the communication with Aseba.
-// AsebaNativeFunctionDescription AsebaNativeDescription_calibrate = {
-// 	"calibrate",
-// 	"Calibrate sensors",
-// 	{
-// 		{0,0},
-// 	}
-// };
-// 
-// void calibrate(AsebaVMState * vm) {
-// 	calibrateSensors();	
-// }
+AsebaNativeFunctionDescription AsebaNativeDescription_setRadioCommands = {
+	"radio.commands.enable",
+	"Enable/disable the commands (motors, leds, ...) sent by the computer through the radio",
+	{
+		{1, "state"},
+		{0,0},
+	}
+};
+
+void setRadioCommands(AsebaVMState * vm) {
+	int enable = vm->variables[AsebaNativePopArg(vm)];
+	if(enable) {
+		rfLegacyCommandsEnabled = 1;
+	} else {
+		rfLegacyCommandsEnabled = 0;
+	}
+}
+
+// The calibration is carried out in the main loop, the "calib" event is emitted when it finishes.
+AsebaNativeFunctionDescription AsebaNativeDescription_calibrate = {
+	"calibrate",
+	"Calibrate sensors",
+	{
+		{0,0},
+	}
+};
+
+void calibrate(AsebaVMState * vm) {
+	calibrateSensorsStart();
+}
+
+AsebaNativeFunctionDescription AsebaNativeDescription_setProxBaseline = {
+	"prox.baseline.enable",
+	"Enable/disable the ambient light tracking of the proximity offsets",
+	{
+		{1, "state"},
+		{0,0},
+	}
+};
+
+void setProxBaseline(AsebaVMState * vm) {
+	int enable = vm->variables[AsebaNativePopArg(vm)];
+	if(enable) {
+		resetProximityBaseline();
+		proxBaselineEnabled = 1;
+	} else {
+		proxBaselineEnabled = 0;
+	}
+}
 
 AsebaNativeFunctionDescription AsebaNativeDescription_resetOdom = {
 	"reset.odometry",
@@ -98,3 +238,82 @@ void isVertical(AsebaVMState * vm) {
 	}
 }
 
+// The channels are listed in logger.h (-1 = unused); with a decimation of 10 the signals are sampled at about 1 KHz.
+AsebaNativeFunctionDescription AsebaNativeDescription_logStart = {
+	"log.start",
+	"Start the high rate logger",
+	{
+		{LOG_MAX_CHANNELS, "channels"},
+		{1, "decimation"},
+		{1, "trigger"},
+		{1, "level"},
+		{1, "pretrigger"},
+		{0,0},
+	}
+};
+
+void logStartNative(AsebaVMState * vm) {
+	sint16 *channels = &vm->variables[AsebaNativePopArg(vm)];
+	int decimation = vm->variables[AsebaNativePopArg(vm)];
+	int trigger = vm->variables[AsebaNativePopArg(vm)];
+	int level = vm->variables[AsebaNativePopArg(vm)];
+	int pretrigger = vm->variables[AsebaNativePopArg(vm)];
+	logDumpEvent = -1;
+	logStart((signed int*)channels, LOG_MAX_CHANNELS, (decimation<1)?1:decimation, (trigger<0)?-1:trigger, level, (pretrigger<0)?0:pretrigger);
+}
+
+AsebaNativeFunctionDescription AsebaNativeDescription_logStop = {
+	"log.stop",
+	"Stop the high rate logger",
+	{
+		{0,0},
+	}
+};
+
+void logStopNative(AsebaVMState * vm) {
+	logStop();
+}
+
+// The frames are sent as the event passed (index of the event in the events list), one message each
+// loop: first frame index, channels number, samples.
+AsebaNativeFunctionDescription AsebaNativeDescription_logDump = {
+	"log.dump",
+	"Send the logger buffer to the computer",
+	{
+		{1, "event"},
+		{0,0},
+	}
+};
+
+void logDumpNative(AsebaVMState * vm) {
+	int event = vm->variables[AsebaNativePopArg(vm)];
+	logStop();
+	if((event < 0) || (logNumCh == 0)) {
+		return;
+	}
+	logDumpIndex = 0;
+	logDumpEvent = event;
+}
+
+// Records saved in eeprom (see blackBox.h): index 0 is the last event; the sequence is -1 when the record doesn't exist.
+AsebaNativeFunctionDescription AsebaNativeDescription_blackBoxRead = {
+	"blackbox.read",
+	"Read an event of the persistent log: sequence, type, argument, data, time (s)",
+	{
+		{1, "index"},
+		{5, "record"},
+		{0,0},
+	}
+};
+
+void blackBoxReadNative(AsebaVMState * vm) {
+	int index = vm->variables[AsebaNativePopArg(vm)];
+	sint16 *record = &vm->variables[AsebaNativePopArg(vm)];
+	unsigned char i = 0;
+	if((index < 0) || (index > 255) || (blackBoxRead(index, (unsigned int*)record) == 0)) {
+		for(i=0; i<5; i++) {
+			record[i] = 0;
+		}
+		record[0] = -1;
+	}
+}
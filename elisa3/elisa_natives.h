@@ -7,32 +7,76 @@
 
 extern AsebaNativeFunctionDescription AsebaNativeDescription_prox_network;
 void prox_network(AsebaVMState *vm);
-// extern AsebaNativeFunctionDescription AsebaNativeDescription_calibrate;
-// void calibrate(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_sendPacket;
+void sendPacket(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_setDiversity;
+void setDiversity(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_setTxMask;
+void setTxMask(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_setGroundInterleave;
+void setGroundInterleave(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_setProxInterleave;
+void setProxInterleave(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_calibrate;
+void calibrate(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_setProxBaseline;
+void setProxBaseline(AsebaVMState *vm);
 extern AsebaNativeFunctionDescription AsebaNativeDescription_setObstacleAvoidance;
 void setObstacleAvoidance(AsebaVMState *vm);
 extern AsebaNativeFunctionDescription AsebaNativeDescription_setCliffAvoidance;
 void setCliffAvoidance(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_setRadioCommands;
+void setRadioCommands(AsebaVMState *vm);
 extern AsebaNativeFunctionDescription AsebaNativeDescription_resetOdom;
 void resetOdom(AsebaVMState *vm);
 extern AsebaNativeFunctionDescription AsebaNativeDescription_isVertical;
 void isVertical(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_logStart;
+void logStartNative(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_logStop;
+void logStopNative(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_logDump;
+void logDumpNative(AsebaVMState *vm);
+extern AsebaNativeFunctionDescription AsebaNativeDescription_blackBoxRead;
+void blackBoxReadNative(AsebaVMState *vm);
 
 #define ELISA_NATIVES_DESCRIPTIONS \
 	&AsebaNativeDescription_prox_network, \
 	&AsebaNativeDescription_setObstacleAvoidance, \
 	&AsebaNativeDescription_setCliffAvoidance, \
+	&AsebaNativeDescription_setRadioCommands, \
 	&AsebaNativeDescription_resetOdom, \
-	&AsebaNativeDescription_isVertical
-	//&AsebaNativeDescription_calibrate
+	&AsebaNativeDescription_isVertical, \
+	&AsebaNativeDescription_calibrate, \
+	&AsebaNativeDescription_setProxBaseline, \
+	&AsebaNativeDescription_sendPacket, \
+	&AsebaNativeDescription_setDiversity, \
+	&AsebaNativeDescription_setTxMask, \
+	&AsebaNativeDescription_setGroundInterleave, \
+	&AsebaNativeDescription_setProxInterleave, \
+	&AsebaNativeDescription_logStart, \
+	&AsebaNativeDescription_logStop, \
+	&AsebaNativeDescription_logDump, \
+	&AsebaNativeDescription_blackBoxRead
 		
 #define ELISA_NATIVES_FUNCTIONS \
 	prox_network, \
 	setObstacleAvoidance, \
 	setCliffAvoidance, \
+	setRadioCommands, \
 	resetOdom, \
-	isVertical
-	//calibrate
+	isVertical, \
+	calibrate, \
+	setProxBaseline, \
+	sendPacket, \
+	setDiversity, \
+	setTxMask, \
+	setGroundInterleave, \
+	setProxInterleave, \
+	logStartNative, \
+	logStopNative, \
+	logDumpNative, \
+	blackBoxReadNative
 
 #endif
 
@@ -0,0 +1,64 @@
+
+#include <stdlib.h>
+#include "irCommCodec.h"
+
+void irCommRemoveMean(signed int *signal, unsigned char len) {
+	unsigned char i = 0;
+	signed long int sum = 0;
+	signed int mean = 0;
+
+	for(i=0; i<len; i++) {
+		sum += signal[i];
+	}
+	mean = (signed int)(sum / len);
+	for(i=0; i<len; i++) {
+		signal[i] -= mean;
+	}
+}
+
+signed long int irCommGoertzelPower(signed int *signal, unsigned char len, signed int coeff) {
+	unsigned char i = 0;
+	signed long int s = 0, s1 = 0, s2 = 0;
+
+	for(i=0; i<len; i++) {
+		s = signal[i] + ((coeff*s1)>>14) - s2;
+		s2 = s1;
+		s1 = s;
+	}
+	return s1*s1 + s2*s2 - ((coeff*s1)>>14)*s2;
+}
+
+unsigned char irCommBitConfidence(signed long int power0, signed long int power1) {
+	// the difference is divided instead of multiplying by 100 to avoid overflows with the powers summed from many sensors
+	if(power0 > power1) {
+		return (unsigned char)((power0-power1)/((power0+power1)/100+1));
+	} else {
+		return (unsigned char)((power1-power0)/((power0+power1)/100+1));
+	}
+}
+
+unsigned char irCommDecodeManchesterBit(signed int *signal, unsigned char halfLen, signed int amplitude, signed int threshold, unsigned char *confidence) {
+	unsigned char i = 0;
+	signed int firstHalf = 0, secondHalf = 0;
+	unsigned int conf = 0;
+
+	for(i=0; i<halfLen; i++) {
+		firstHalf += signal[i];
+		secondHalf += signal[halfLen+i];
+	}
+	if(abs(firstHalf-secondHalf) < threshold) {	// no transition in the middle of the bit
+		*confidence = 0;
+		return IRCOMM_CODEC_NO_BIT;
+	}
+	// confidence: difference between the halves compared to the one of a full amplitude transition
+	conf = (unsigned int)((signed long int)abs(firstHalf-secondHalf)*100/((signed long int)amplitude*halfLen));
+	if(conf > 100) {
+		conf = 100;
+	}
+	*confidence = (unsigned char)conf;
+	if(firstHalf < secondHalf) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef IR_COMM_CODEC_H
+#define IR_COMM_CODEC_H
+
+
+/**
+ * \file irCommCodec
+ * \brief IR local communication signal decoding
+ * \author Stefano Morgani <stefano@gctronic.com>
+ * \version 1.0
+ * \date 19.10.26
+ * \copyright GNU GPL v3
+
+ The module contains the signal processing used to decide the received bits from the sampling windows of
+ the proximity sensors (Goertzel detector for the frequency line code, halves comparison for the Manchester
+ line code). The functions work only on the data passed as arguments: they don't access the global variables
+ nor the microcontroller registers, thus they can be compiled and exercised also outside the robot (e.g. feeding
+ recorded or simulated sampling windows, see tests/testIrCodec.c).
+*/
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IRCOMM_CODEC_NO_BIT 0xFF	// the bit cannot be decided
+
+/**
+ * \brief Remove the mean value from the samples of a sampling window.
+ * \param signal samples
+ * \param len number of samples
+ * \return none
+ */
+void irCommRemoveMean(signed int *signal, unsigned char len);
+
+/**
+ * \brief Compute the power of the signal at one frequency with the Goertzel algorithm.
+ * \param signal samples with the mean removed
+ * \param len number of samples (N)
+ * \param coeff 2*cos(2*pi*k/N) in Q14 format, where k is the number of cycles in the window
+ * \return the power of the signal at the chosen frequency
+ */
+signed long int irCommGoertzelPower(signed int *signal, unsigned char len, signed int coeff);
+
+/**
+ * \brief Compute the confidence of a bit decided comparing the power at the two bits frequencies.
+ * \param power0 power at the frequency of "0"
+ * \param power1 power at the frequency of "1"
+ * \return confidence from 0 (same power) to 100 (only one frequency present)
+ */
+unsigned char irCommBitConfidence(signed long int power0, signed long int power1);
+
+/**
+ * \brief Decide a Manchester encoded bit ("1" = IR on then off, "0" = IR off then on) comparing the sum of the samples
+ * of its two halves; the IR light received lowers the sensor value.
+ * \param signal samples of the bit (2*halfLen samples)
+ * \param halfLen number of samples in each half of the bit
+ * \param amplitude difference between the maximum and minimum value of the sampling window
+ * \param threshold minimum difference between the sums of the two halves
+ * \param confidence the confidence of the bit (0..100) is returned here
+ * \return 0 or 1, IRCOMM_CODEC_NO_BIT if there is no transition in the middle of the bit
+ */
+unsigned char irCommDecodeManchesterBit(signed int *signal, unsigned char halfLen, signed int amplitude, signed int threshold, unsigned char *confidence);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
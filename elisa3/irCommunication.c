@@ -1,5 +1,10 @@
 #include "irCommunication.h"
 
+// amplitude of the received signal (adc units) at different distances (mm) between the robots; rough 
+// characterization, to be tuned for the specific environment
+static const unsigned int irCommDistanceAmplitude[IRCOMM_DISTANCE_POINTS] = {900, 600, 350, 200, 120, 80};
+static const unsigned int irCommDistanceMm[IRCOMM_DISTANCE_POINTS] = {10, 20, 30, 40, 50, 60};
+
 
 void irCommInitTransmitter() {
 	irCommEnabled = IRCOMM_MODE_TRANSMIT;
@@ -16,9 +21,16 @@ void irCommInitVars() {
 	memset(irCommMaxSensorValueAdc, 0x00, 16);
 	memset(irCommMinSensorValueAdc, 0xFF, 16);
 	irCommMode = IRCOMM_MODE_SENSORS_SAMPLING;
+	irCommTxQueueHead = 0;
+	irCommTxQueueTail = 0;
+	irCommRxQueueHead = 0;
+	irCommRxQueueTail = 0;
+	irCommRxPktState = IRCOMM_PKT_WAIT_START;
 }
 
-void irCommInit() {
+void irCommInit(unsigned char lineCode) {
+	irCommLineCode = lineCode;
+	srand(rfAddress ^ (unsigned int)getTime100MicroSec());	// different backoff sequence for each robot
 	irCommProxValuesAdc = irCommProxValuesBuff1;
 	irCommProxValuesCurr = irCommProxValuesBuff2;
 	irCommMaxSensorValueAdc = irCommMaxSensorValueBuff1;
@@ -37,24 +49,56 @@ void irCommDeinit() {
 void irCommTasks() {
 	int i = 0;
 
+	// remove the neighbours not perceived anymore
+	for(i=0; i<IRCOMM_MAX_NEIGHBOURS; i++) {
+		if((irCommNeighbourId[i]>=0) && ((getTime100MicroSec()-irCommNeighbourTime[i]) > IRCOMM_NEIGHBOUR_TIMEOUT)) {
+			irCommNeighbourId[i] = -1;
+		}
+	}
+
+	// send the next byte of the queued packets as soon as the previous one is transmitted
+	if((irCommTxByteEnqueued==0) && (irCommTxQueueHead!=irCommTxQueueTail)) {
+		irCommSendData(irCommTxQueue[irCommTxQueueTail]);
+		irCommTxQueueTail = (irCommTxQueueTail+1)&(IRCOMM_QUEUE_SIZE-1);
+	}
+
 	if(irCommMode==IRCOMM_MODE_RECEIVE) {
 
 		switch(irCommState) {
 			case IRCOMM_RX_IDLE_STATE:				
 				if((irCommRxStartBitDetected==0) && (irCommEnabled!=irCommEnabledNext)) {
-					if((getTime100MicroSec() - irCommTxLastTransmissionTime) > PAUSE_200_MSEC) {
-						irCommInitTransmitter();
+					if(((getTime100MicroSec() - irCommTxLastTransmissionTime) > PAUSE_200_MSEC) && ((getTime100MicroSec() - irCommTxBackoffStart) > irCommTxBackoff)) {
+						// listen before talk: if a neighbour is transmitting wait a random time, that grows exponentially
+						// at each consecutive busy channel, in order to reduce the collisions
+						if((getTime100MicroSec() - irCommRxLastBusyTime) < IRCOMM_CARRIER_SENSE_TIME) {
+							if(irCommTxBackoffExp < IRCOMM_BACKOFF_MAX_EXP) {
+								irCommTxBackoffExp++;
+							}
+							irCommTxBackoff = rand() % (IRCOMM_BACKOFF_SLOT<<irCommTxBackoffExp);
+							irCommTxBackoffStart = getTime100MicroSec();
+							irCommTxDeferredCount++;
+						} else {
+							irCommTxBackoffExp = 0;
+							irCommTxBackoff = rand() % IRCOMM_BACKOFF_SLOT;	// small jitter to desynchronize the robots
+							irCommTxBackoffStart = getTime100MicroSec();
+							irCommTxCount++;
+							irCommInitTransmitter();
+						}
 					}					
 				}
 				break;
 
 			case IRCOMM_RX_MAX_SENSOR_STATE:
 				// check from how many sensors the robot is receiving a possible message
+				irCommRxNumReceivingSensors = 0;
 				for(i=0; i<8; i++) {
 					if((signed int)(irCommMaxSensorValueCurr[i]-irCommMinSensorValueCurr[i]) >= IRCOMM_DETECTION_AMPLITUDE_THR) {
 						irCommRxNumReceivingSensors++;
 					}					
 				}
+				if(irCommRxNumReceivingSensors > 0) {
+					irCommRxLastBusyTime = getTime100MicroSec();
+				}
 				if(irCommRxNumReceivingSensors==0) {
 					irCommRxStartBitDetected = 0;
 					currentProx = 0;
@@ -106,24 +150,7 @@ void irCommTasks() {
 
 					// transmit debug information
 					if(DEBUG_MAX_SENSOR_STATE) {
-						irCommSendValues = 0;						
-						while(irCommSendValues==0);	// wait for the start from the uart (computer)
-						usart0Transmit(0xFF, 1);
-						usart0Transmit(irCommRxMaxSensor,1);
-						usart0Transmit(irCommRxMaxDiff&0xFF,1);
-						usart0Transmit(irCommRxMaxDiff>>8,1);
-						if(DEBUG_ALL_SENSORS) {
-							for(i=0; i<8*IRCOMM_SAMPLING_WINDOW; i++) {
-								usart0Transmit(irCommProxValuesCurr[i]&0xFF,1);
-								usart0Transmit(irCommProxValuesCurr[i]>>8,1);
-							}
-						} else if(DEBUG_MAX_SENSOR) {
-							for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
-								irCommTempValue = irCommProxValuesCurr[irCommRxMaxSensor+i*8];
-								usart0Transmit(irCommTempValue&0xFF,1);
-								usart0Transmit(irCommTempValue>>8,1);
-							}
-						}
+						irCommCaptureWindow(IRCOMM_CAPTURE_DETECTION, DEBUG_ALL_SENSORS);
 					}
 				} else {
 					// cannot get a reliable signal from the sensor from which the start bit was detected the previous time,
@@ -149,6 +176,9 @@ void irCommTasks() {
 				break;
 
 			case IRCOMM_RX_DETECT_START_BIT_STATE:
+				if(DEBUG_START_BIT_STATE) {
+					irCommCaptureWindow(IRCOMM_CAPTURE_START_BIT, 0);
+				}
 				// extract signal from the sensor with higher amplitude and compute the signal mean
 				irCommProxSum = 0;
 				irCommTempMin = 1024;
@@ -220,7 +250,7 @@ void irCommTasks() {
 					irCommSignalState = 1;
 				} else {
 					irCommSignalState = -1;
-				}
+				}
 				irCommSwitchCount = 0;
 				for(i=1; i<IRCOMM_SAMPLING_WINDOW; i++) {
 					if(irCommMaxSensorSignal[i] > 0) {
@@ -397,6 +427,13 @@ void irCommTasks() {
 				break;
 
 			case IRCOMM_RX_READ_BIT:
+				if(DEBUG_READ_BIT) {
+					irCommCaptureWindow(IRCOMM_CAPTURE_BIT, 0);
+				}
+				if(irCommLineCode == IRCOMM_CODE_MANCHESTER) {
+					irCommRxReadManchesterBits();
+					break;
+				}
 				// extract signal from the sensor with higher amplitude and compute the signal mean
 				irCommProxSum = 0;
 				irCommTempMin = 1024;
@@ -422,40 +459,37 @@ void irCommTasks() {
 					break;
 				}
 
-				irCommProxMean = (int)(irCommProxSum / IRCOMM_SAMPLING_WINDOW);
+				irCommRxUpdateStrength();
 
-				// substract mean from signal
-				for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
-					irCommMaxSensorSignal[i] -= irCommProxMean;
-				}
-						
-				// start counting number of switch around mean signal
-				if(irCommMaxSensorSignal[0] > 0) {
-					irCommSignalState = 1;
-				} else {
-					irCommSignalState = -1;
-				}
-				irCommSwitchCount = 0;
-				for(i=1; i<IRCOMM_SAMPLING_WINDOW; i++) {
-					if(irCommMaxSensorSignal[i] > 0) {
-						if(irCommSignalState < 0) {
-							irCommSignalState = 1;
-							irCommSwitchCount++;
-						}
-					} else {
-						if(irCommSignalState > 0) {
-							irCommSignalState = -1;
-							irCommSwitchCount++;
+				// compare the power of the signal at the two bits frequencies; with diversity combining the powers of
+				// all the sensors that perceive the signal are summed, otherwise only the selected sensor is used
+				irCommPowerBit0 = 0;
+				irCommPowerBit1 = 0;
+				if(irCommRxDiversityEnabled) {
+					for(i=0; i<8; i++) {
+						if((signed int)(irCommMaxSensorValueCurr[i]-irCommMinSensorValueCurr[i]) >= IRCOMM_DETECTION_AMPLITUDE_THR) {
+							irCommRxAddSensorPower(i);
 						}
 					}
+				} else {
+					irCommRxAddSensorPower(irCommRxMaxSensor);
 				}
+				irCommRxBitConfidence[irCommRxBitCount] = irCommBitConfidence(irCommPowerBit0, irCommPowerBit1);
+
 				// check whether we received either a "0" or a "1"
-				if(irCommSwitchCount >= (IRCOMM_BIT0_SWITCH_COUNT-2)) {
+				if(irCommRxBitConfidence[irCommRxBitCount] < IRCOMM_GOERTZEL_MIN_CONF) {
+					irCommSwitchCount = 0;	// the bit cannot be distinguished
+				} else if(irCommPowerBit0 > irCommPowerBit1) {
+					irCommSwitchCount = IRCOMM_BIT0_SWITCH_COUNT;
+				} else {
+					irCommSwitchCount = IRCOMM_BIT1_SWITCH_COUNT;
+				}
+				if(irCommSwitchCount == IRCOMM_BIT0_SWITCH_COUNT) {
 					irCommRxBitReceived[irCommRxBitCount] = 0;
 					if(irCommRxBitCount<8) {	// do not consider the crc for byte interpretation
 						irCommRxByte = irCommRxByte<<1;	// bit0, only shift
 					}
-				} else if(irCommSwitchCount >= (IRCOMM_BIT1_SWITCH_COUNT-1)) {
+				} else if(irCommSwitchCount == IRCOMM_BIT1_SWITCH_COUNT) {
 					irCommRxBitReceived[irCommRxBitCount] = 1;
 					if(irCommRxBitCount<8) {	// do not consider the crc for byte interpretation
 						irCommRxCrc++;
@@ -488,12 +522,29 @@ void irCommTasks() {
 			case IRCOMM_RX_CHECK_CRC:
 				irCommRxCrcError = (irCommRxCrc + (irCommRxBitReceived[8]<<1) + irCommRxBitReceived[9])&0x03;
 				if(irCommRxCrcError==0) {
-					irCommRxLastDataReceived = irCommRxByte;
 					irCommRxReceivingSensor = irCommRxMaxSensor;
-					irCommRxDataAvailable = 1;
+					for(i=0; i<8; i++) {
+						irCommRxSensorStrength[i] = irCommRxSensorAmplitude[i];
+					}
+					irCommComputeRangeBearing();
+					irCommRxLastConfidence = 100;
+					for(i=0; i<10; i++) {
+						if(irCommRxLastConfidence > irCommRxBitConfidence[i]) {
+							irCommRxLastConfidence = irCommRxBitConfidence[i];
+						}
+					}
+					if(irCommRxPacketByte(irCommRxByte) == 0) {	// not part of a packet
+						irCommRxLastDataReceived = irCommRxByte;
+						irCommRxDataAvailable = 1;
+					}
 					//updateBlueLed(0);
 					//usart0Transmit(irCommRxByte,1);		
 					//updateBlueLed(255);			
+				} else {
+					irCommRxErrorCount++;
+				}
+				if(DEBUG_BYTE_RECEPTION) {
+					irCommCaptureByte();
 				}
 												
 				currentProx = 0;
@@ -536,6 +587,35 @@ void irCommTasks() {
 				irCommTxCrc = 4 - irCommTxCrc;
 				irCommTxBitToTransmit[10] = (irCommTxCrc>>1)&0x01;
 				irCommTxBitToTransmit[11] = irCommTxCrc&0x01;	
+				if(irCommLineCode == IRCOMM_CODE_MANCHESTER) {	// data and crc sent as a single block of half bits
+					irCommTxManchester = 0;
+					for(i=0; i<10; i++) {
+						if(irCommTxBitToTransmit[i+2] == 1) {
+							irCommTxManchester |= (1UL<<(i*2));		// on-off
+						} else {
+							irCommTxManchester |= (1UL<<(i*2+1));	// off-on
+						}
+					}
+					irCommTxBitToTransmit[2] = IRCOMM_BIT_MANCHESTER_BLOCK;
+					irCommTxBitTotal = 3;
+				} else {
+					irCommTxBitTotal = 12;
+				}
+				// sensors used for the transmission: when more than 4 sensors are selected they are divided in two 
+				// groups of alternating sensors (used one at a time) to limit the istantaneous power consumption
+				irCommTxSensorCount = 0;
+				for(i=0; i<8; i++) {
+					if(irCommTxSensorMask & (1<<i)) {
+						irCommTxSensorCount++;
+					}
+				}
+				if(irCommTxSensorCount <= 4) {
+					irCommTxPattern = irCommTxSensorMask;
+				} else if(irCommTxSensorGroup==0) {
+					irCommTxPattern = irCommTxSensorMask & 0xAA;
+				} else {
+					irCommTxPattern = irCommTxSensorMask & 0x55;
+				}
 				irCommTxBitCount = 0;							
 				irCommTxPulseState = 0;	
 				irCommState = IRCOMM_TX_COMPUTE_TIMINGS;				
@@ -543,7 +623,16 @@ void irCommTasks() {
 
 			case IRCOMM_TX_COMPUTE_TIMINGS:
 				//updateBlueLed(255);
-				if(irCommTxBitToTransmit[irCommTxBitCount] == 3) {
+				if(irCommTxBitToTransmit[irCommTxBitCount] == IRCOMM_BIT_MANCHESTER_BLOCK) {
+					irCommTxDuration = IRCOMM_MANCHESTER_HALF_DURATION;
+					irCommTxSwitchCount = IRCOMM_MANCHESTER_HALF_BITS;
+					irCommTxPulseState = irCommTxManchester&0x01;	// level of the first half bit
+					if(irCommTxPulseState == 0) {
+						PORTA = 0x00;
+					} else {
+						PORTA = irCommTxPattern;
+					}
+				} else if(irCommTxBitToTransmit[irCommTxBitCount] == 3) {
 					//updateBlueLed(0);
 					irCommTxDuration = IRCOMM_BIT_START2_DURATION;					
 					irCommTxSwitchCount = IRCOMM_BIT_START2_SWITCH_COUNT;
@@ -559,12 +648,7 @@ void irCommTasks() {
 					irCommTxSwitchCount = IRCOMM_BIT0_SWITCH_COUNT;
 				}
 				if(irCommTxBitCount == 0) {
-					//PORTA = irCommTxSensorMask;
-					if(irCommTxSensorGroup==0) {
-						PORTA = 0xAA;
-					} else {
-						PORTA = 0x55;
-					}					
+					PORTA = irCommTxPattern;
 					irCommTxPulseState = 1;
 				}
 				irCommTxDurationCycle = 0;
@@ -582,12 +666,152 @@ void irCommTasks() {
 
 }
 
-//void irCommSendData(unsigned char value, unsigned char sensorMask) {
-//	irCommTxByte = value;
-//	irCommTxByteEnqueued = 1;
-//	irCommTxSensorMask = sensorMask;
-//	irCommEnabledNext = IRCOMM_MODE_TRANSMIT;
-//}
+void irCommRxAddSensorPower(unsigned char sensor) {
+	unsigned char i = 0;
+
+	for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+		irCommMaxSensorSignal[i] = irCommProxValuesCurr[sensor+i*8];
+	}
+	irCommRemoveMean(irCommMaxSensorSignal, IRCOMM_SAMPLING_WINDOW);
+	irCommPowerBit0 += irCommGoertzelPower(irCommMaxSensorSignal, IRCOMM_SAMPLING_WINDOW, IRCOMM_GOERTZEL_COEFF_BIT0);
+	irCommPowerBit1 += irCommGoertzelPower(irCommMaxSensorSignal, IRCOMM_SAMPLING_WINDOW, IRCOMM_GOERTZEL_COEFF_BIT1);
+}
+
+void irCommRxUpdateStrength() {
+	unsigned char i = 0;
+	unsigned int amplitude = 0;
+
+	if(irCommRxBitCount == 0) {		// first bit of a new byte
+		memset(irCommRxSensorAmplitude, 0x00, 16);
+	}
+	for(i=0; i<8; i++) {
+		amplitude = irCommMaxSensorValueCurr[i]-irCommMinSensorValueCurr[i];
+		if((amplitude < 1024) && (amplitude >= IRCOMM_DETECTION_AMPLITUDE_THR) && (amplitude > irCommRxSensorAmplitude[i])) {
+			irCommRxSensorAmplitude[i] = amplitude;
+		}
+	}
+}
+
+void irCommRxReadManchesterBits() {
+	int i = 0;
+	unsigned char j = 0;
+	unsigned char bit = 0;
+
+	irCommTempMin = 1024;
+	irCommTempMax = 0;
+	for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+		irCommMaxSensorSignal[i] = irCommProxValuesCurr[irCommRxMaxSensor+i*8];
+		if(irCommTempMin > irCommMaxSensorSignal[i]) {
+			irCommTempMin = irCommMaxSensorSignal[i];
+		}
+		if(irCommTempMax < irCommMaxSensorSignal[i]) {
+			irCommTempMax = irCommMaxSensorSignal[i];
+		}
+	}
+
+	if((irCommTempMax-irCommTempMin) >= IRCOMM_DETECTION_AMPLITUDE_THR) {
+		irCommRxUpdateStrength();
+		for(j=0; j<2; j++) {	// two bits in each sampling window, each made of two halves of 5 samples
+			bit = irCommDecodeManchesterBit(&irCommMaxSensorSignal[j*(IRCOMM_SAMPLING_WINDOW/2)], IRCOMM_SAMPLING_WINDOW/4, 
+											irCommTempMax-irCommTempMin, IRCOMM_MANCHESTER_THR, &irCommRxBitConfidence[irCommRxBitCount]);
+			if(bit == IRCOMM_CODEC_NO_BIT) {
+				break;
+			}
+			if(bit == 1) {
+				irCommRxBitReceived[irCommRxBitCount] = 1;
+				if(irCommRxBitCount<8) {
+					irCommRxCrc++;
+					irCommRxByte = (irCommRxByte<<1) + 1;
+				}
+			} else {
+				irCommRxBitReceived[irCommRxBitCount] = 0;
+				if(irCommRxBitCount<8) {
+					irCommRxByte = irCommRxByte<<1;
+				}
+			}
+			irCommRxBitCount++;
+		}
+		if(j == 2) {
+			if(irCommRxBitCount == 10) {	// received 8 bit of data + 2 bit of crc
+				irCommState = IRCOMM_RX_CHECK_CRC;
+			} else {
+				irCommState = IRCOMM_RX_WAITING_BIT;
+			}
+			return;
+		}
+	}
+
+	// error...no significant signal perceived
+	currentProx = 0;
+	adcSaveDataTo = SKIP_SAMPLE;
+	adcSamplingState = 0;
+	irCommMode=IRCOMM_MODE_SENSORS_SAMPLING;
+	irCommState = IRCOMM_RX_IDLE_STATE;
+}
+
+void irCommCaptureStart(unsigned char type, unsigned int len) {
+	irCommCaptureCrc = 0;
+	usart0Transmit(IRCOMM_CAPTURE_SYNC0, 1);
+	usart0Transmit(IRCOMM_CAPTURE_SYNC1, 1);
+	irCommCapturePut(IRCOMM_CAPTURE_VERSION);
+	irCommCapturePut(type);
+	irCommCapturePut(len&0xFF);
+	irCommCapturePut(len>>8);
+}
+
+void irCommCapturePut(unsigned char value) {
+	irCommCaptureCrc = crc8Update(irCommCaptureCrc, value);
+	usart0Transmit(value, 1);
+}
+
+void irCommCaptureWindow(unsigned char type, unsigned char allSensors) {
+	unsigned int i = 0;
+	unsigned char numSensors = 1;
+	unsigned long int time = getTime100MicroSec();
+
+	if(allSensors) {
+		numSensors = 8;
+	}
+	irCommCaptureStart(type, 8+numSensors*IRCOMM_SAMPLING_WINDOW*2);
+	irCommCapturePut(time&0xFF);
+	irCommCapturePut((time>>8)&0xFF);
+	irCommCapturePut(irCommLineCode);
+	irCommCapturePut(irCommRxMaxSensor);
+	irCommCapturePut(irCommRxBitCount);
+	irCommCapturePut(irCommRxMaxDiff&0xFF);
+	irCommCapturePut(irCommRxMaxDiff>>8);
+	irCommCapturePut(numSensors);
+	if(allSensors) {	// samples interleaved as in the reception buffer (sensor 0..7 of the first sample, ...)
+		for(i=0; i<8*IRCOMM_SAMPLING_WINDOW; i++) {
+			irCommCapturePut(irCommProxValuesCurr[i]&0xFF);
+			irCommCapturePut(irCommProxValuesCurr[i]>>8);
+		}
+	} else {
+		for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+			irCommTempValue = irCommProxValuesCurr[irCommRxMaxSensor+i*8];
+			irCommCapturePut(irCommTempValue&0xFF);
+			irCommCapturePut(irCommTempValue>>8);
+		}
+	}
+	usart0Transmit(irCommCaptureCrc, 1);
+}
+
+void irCommCaptureByte() {
+	unsigned long int time = getTime100MicroSec();
+
+	irCommCaptureStart(IRCOMM_CAPTURE_BYTE, 6);
+	irCommCapturePut(time&0xFF);
+	irCommCapturePut((time>>8)&0xFF);
+	irCommCapturePut(irCommRxMaxSensor);
+	irCommCapturePut(irCommRxByte);
+	irCommCapturePut(irCommRxCrcError);
+	irCommCapturePut(irCommRxLastConfidence);
+	usart0Transmit(irCommCaptureCrc, 1);
+}
+
+void irCommSetTxSensorMask(unsigned char sensorMask) {
+	irCommTxSensorMask = sensorMask;
+}
 
 void irCommSendData(unsigned char value) {
 	irCommTxByte = value;
@@ -612,6 +836,245 @@ unsigned char irCommReadData() {
 	return irCommRxLastDataReceived;
 }
 
+unsigned char irCommTxQueueFree() {
+	return (IRCOMM_QUEUE_SIZE-1) - ((irCommTxQueueHead-irCommTxQueueTail)&(IRCOMM_QUEUE_SIZE-1));
+}
+
+void irCommTxQueuePut(unsigned char value) {
+	irCommTxQueue[irCommTxQueueHead] = value;
+	irCommTxQueueHead = (irCommTxQueueHead+1)&(IRCOMM_QUEUE_SIZE-1);
+}
+
+unsigned char irCommSendPacket(unsigned char *data, unsigned char len) {
+	unsigned char i = 0;
+	unsigned char pkt[IRCOMM_PKT_MAX_PAYLOAD+3];
+
+	if((len==0) || (len>IRCOMM_PKT_MAX_PAYLOAD) || (irCommTxQueueFree() < (len+5))) {
+		return 0;
+	}
+
+	pkt[0] = len;
+	pkt[1] = rfAddress&0xFF;
+	pkt[2] = irCommTxPktSeq++;
+	for(i=0; i<len; i++) {
+		pkt[i+3] = data[i];
+	}
+
+	irCommTxQueuePut(IRCOMM_PKT_START);
+	for(i=0; i<len+3; i++) {
+		irCommTxQueuePut(pkt[i]);
+	}
+	irCommTxQueuePut(crc8(pkt, len+3));	// crc of length, sender, sequence and payload
+	return 1;
+}
+
+unsigned char irCommTxQueueEmpty() {
+	if(irCommTxQueueHead==irCommTxQueueTail) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+unsigned char irCommRxPacketByte(unsigned char value) {
+
+	unsigned char len = 0;
+	unsigned char i = 0;
+
+	if((irCommRxPktState!=IRCOMM_PKT_WAIT_START) && ((getTime100MicroSec()-irCommRxPktLastByteTime) > IRCOMM_PKT_TIMEOUT)) {
+		irCommRxPktState = IRCOMM_PKT_WAIT_START;	// packet interrupted, wait for the next one
+	}
+	irCommRxPktLastByteTime = getTime100MicroSec();
+
+	switch(irCommRxPktState) {
+		case IRCOMM_PKT_WAIT_START:
+			if(value != IRCOMM_PKT_START) {
+				return 0;
+			}
+			irCommRxPktIndex = 0;
+			irCommRxPktState = IRCOMM_PKT_LEN;
+			break;
+
+		case IRCOMM_PKT_LEN:
+			if((value==0) || (value>IRCOMM_PKT_MAX_PAYLOAD)) {	// not a packet
+				irCommRxPktState = IRCOMM_PKT_WAIT_START;
+				return 0;
+			}
+			irCommRxPktBuff[irCommRxPktIndex++] = value;
+			irCommRxPktState = IRCOMM_PKT_SRC;
+			break;
+
+		case IRCOMM_PKT_SRC:
+			irCommRxPktBuff[irCommRxPktIndex++] = value;
+			irCommRxPktState = IRCOMM_PKT_SEQ;
+			break;
+
+		case IRCOMM_PKT_SEQ:
+			irCommRxPktBuff[irCommRxPktIndex++] = value;
+			irCommRxPktState = IRCOMM_PKT_PAYLOAD;
+			break;
+
+		case IRCOMM_PKT_PAYLOAD:
+			irCommRxPktBuff[irCommRxPktIndex++] = value;
+			if(irCommRxPktIndex == (irCommRxPktBuff[0]+3)) {
+				irCommRxPktState = IRCOMM_PKT_CRC;
+			}
+			break;
+
+		case IRCOMM_PKT_CRC:
+			irCommRxPktState = IRCOMM_PKT_WAIT_START;
+			len = irCommRxPktBuff[0];
+			if(value != crc8(irCommRxPktBuff, len+3)) {
+				break;	// corrupted packet, discard it
+			}
+			if(((IRCOMM_QUEUE_SIZE-1) - ((irCommRxQueueHead-irCommRxQueueTail)&(IRCOMM_QUEUE_SIZE-1))) < (len+4)) {
+				break;	// no space left in the rx queue, discard the packet
+			}
+			for(i=0; i<len+4; i++) {	// length, sender, sequence, sensor, payload
+				if(i < 3) {
+					irCommRxQueue[irCommRxQueueHead] = irCommRxPktBuff[i];
+				} else if(i == 3) {
+					irCommRxQueue[irCommRxQueueHead] = irCommRxReceivingSensor;
+				} else {
+					irCommRxQueue[irCommRxQueueHead] = irCommRxPktBuff[i-1];
+				}
+				irCommRxQueueHead = (irCommRxQueueHead+1)&(IRCOMM_QUEUE_SIZE-1);
+			}
+			break;
+	}
+
+	return 1;
+
+}
+
+unsigned char irCommPacketAvailable() {
+	if(irCommRxQueueHead==irCommRxQueueTail) {
+		return 0;
+	} else {
+		return 1;
+	}
+}
+
+unsigned char irCommReadPacket(unsigned char *data, unsigned char *src, unsigned char *seq, signed char *sensor) {
+	unsigned char len = 0;
+	unsigned char i = 0;
+
+	if(irCommRxQueueHead==irCommRxQueueTail) {
+		return 0;
+	}
+
+	len = irCommRxQueue[irCommRxQueueTail];
+	*src = irCommRxQueue[(irCommRxQueueTail+1)&(IRCOMM_QUEUE_SIZE-1)];
+	*seq = irCommRxQueue[(irCommRxQueueTail+2)&(IRCOMM_QUEUE_SIZE-1)];
+	*sensor = irCommRxQueue[(irCommRxQueueTail+3)&(IRCOMM_QUEUE_SIZE-1)];
+	irCommRxQueueTail = (irCommRxQueueTail+4)&(IRCOMM_QUEUE_SIZE-1);
+	for(i=0; i<len; i++) {
+		data[i] = irCommRxQueue[irCommRxQueueTail];
+		irCommRxQueueTail = (irCommRxQueueTail+1)&(IRCOMM_QUEUE_SIZE-1);
+	}
+	return len;
+}
+
+unsigned char irCommReceivedConfidence() {
+	return irCommRxLastConfidence;
+}
+
+void irCommComputeRangeBearing() {
+	unsigned char i = 0;
+	unsigned char maxSensor = 0, nextSensor = 0, prevSensor = 0, neighbourSensor = 0;
+	unsigned int maxAmp = 0, neighbourAmp = 0;
+	signed int offset = 0;
+
+	for(i=1; i<8; i++) {
+		if(irCommRxSensorStrength[i] > irCommRxSensorStrength[maxSensor]) {
+			maxSensor = i;
+		}
+	}
+	maxAmp = irCommRxSensorStrength[maxSensor];
+
+	// bearing: interpolate between the sensor with the strongest signal and its strongest adjacent sensor
+	// (sensors are 45 degrees apart, id increases clockwise)
+	nextSensor = (maxSensor+1)&0x07;
+	prevSensor = (maxSensor+7)&0x07;
+	if(irCommRxSensorStrength[nextSensor] >= irCommRxSensorStrength[prevSensor]) {
+		neighbourSensor = nextSensor;
+		offset = -45;
+	} else {
+		neighbourSensor = prevSensor;
+		offset = 45;
+	}
+	neighbourAmp = irCommRxSensorStrength[neighbourSensor];
+	irCommRxBearing = getBearing(maxSensor);
+	if((maxAmp+neighbourAmp) > 0) {
+		irCommRxBearing += (signed int)((signed long int)offset*neighbourAmp/(maxAmp+neighbourAmp));
+	}
+	if(irCommRxBearing > 180) {
+		irCommRxBearing -= 360;
+	} else if(irCommRxBearing <= -180) {
+		irCommRxBearing += 360;
+	}
+
+	// distance: linear interpolation of the amplitude to distance curve
+	if(maxAmp >= irCommDistanceAmplitude[0]) {
+		irCommRxDistance = irCommDistanceMm[0];
+	} else if(maxAmp <= irCommDistanceAmplitude[IRCOMM_DISTANCE_POINTS-1]) {
+		irCommRxDistance = irCommDistanceMm[IRCOMM_DISTANCE_POINTS-1];
+	} else {
+		for(i=1; i<IRCOMM_DISTANCE_POINTS; i++) {
+			if(maxAmp >= irCommDistanceAmplitude[i]) {
+				irCommRxDistance = irCommDistanceMm[i] - (unsigned int)((unsigned long int)(maxAmp-irCommDistanceAmplitude[i])*(irCommDistanceMm[i]-irCommDistanceMm[i-1])/(irCommDistanceAmplitude[i-1]-irCommDistanceAmplitude[i]));
+				break;
+			}
+		}
+	}
+}
+
+signed int irCommRxBearingEstimate() {
+	return irCommRxBearing;
+}
+
+unsigned int irCommRxDistanceEstimate() {
+	return irCommRxDistance;
+}
+
+signed char irCommUpdateNeighbour(unsigned char id) {
+	unsigned char i = 0;
+	signed char entry = -1;
+
+	// look for the neighbour, otherwise take a free entry or replace the oldest one
+	for(i=0; i<IRCOMM_MAX_NEIGHBOURS; i++) {
+		if(irCommNeighbourId[i] == id) {
+			entry = i;
+			break;
+		}
+	}
+	if(entry < 0) {
+		for(i=0; i<IRCOMM_MAX_NEIGHBOURS; i++) {
+			if(irCommNeighbourId[i] < 0) {
+				entry = i;
+				break;
+			}
+		}
+	}
+	if(entry < 0) {
+		entry = 0;
+		for(i=1; i<IRCOMM_MAX_NEIGHBOURS; i++) {
+			if(irCommNeighbourTime[i] < irCommNeighbourTime[entry]) {
+				entry = i;
+			}
+		}
+	}
+	irCommNeighbourId[entry] = id;
+	irCommNeighbourBearing[entry] = irCommRxBearing;
+	irCommNeighbourDistance[entry] = irCommRxDistance;
+	irCommNeighbourTime[entry] = getTime100MicroSec();
+	return entry;
+}
+
+unsigned int irCommReceivingStrength(unsigned char sensor) {
+	return irCommRxSensorStrength[sensor];
+}
+
 signed char irCommReceivingSensor() {
 	return irCommRxReceivingSensor;
 }
@@ -15,6 +15,8 @@
  A simple communication protocol is used: "0" and "1" are encoded with different signal frequencies, moreover 
  2 start bits (used to detect the data and then to sync with it) and 2 CRC bits are used for each byte, that is 
  for each byte 12 bits are exchanged.
+ Alternatively the data and CRC bits can be Manchester encoded ("1" = IR on then off, "0" = IR off then on), two
+ bits in each sampling window; the start bits are the same, thus a byte takes 7 sampling windows instead of 12.
  When the IR local communication is initialized the robot starts listening for incoming data; when the user decides 
  to send a byte the robot stops listening and starts transmitting the required data and then continues listening.
  The proximity and ground sensors can still be used when the IR local communication is enabled, this means that the 
@@ -23,21 +25,46 @@
  transmitting data.
  The IR local communication is implemented using a state machine, in order for the state machine to work the function "irCommTasks"
  need to be called as fast as possible (put it in you main loop).
+ Besides single bytes, small packets (up to IRCOMM_PKT_MAX_PAYLOAD bytes) can be exchanged; they are queued and sent
+ byte by byte with the following format: start byte (IRCOMM_PKT_START), length, sender id (robot address), sequence number,
+ payload, CRC-8. The received packets are verified and queued, single bytes that aren't part of a packet are still
+ available with "irCommReadData".
  Limitations:
- - no RX or TX queue (one byte at a time): use the function "irCommDataSent" to know when the next byte can be sent and 
- the function "irCommDataAvailable" when the next data can be read
- - reduced sensors frequency update: in the worst case (cotinuously receiving and transmitting data) is about 3 Hz; 
- this means that the grounds cannot be used for cliff avoidance
- - the data are sent using all the sensors, cannot select a single sensors from which to send the data. Moreover the data isn't sent
- contemporaneously from all the sensors, but the sensors used are divided in two groups of 4 alternating sensors; this is to reduce 
- the istantaneous power consumption required by all the sensors.
+ - single bytes aren't queued (one byte at a time): use the function "irCommDataSent" to know when the next byte can be sent and 
+ the function "irCommDataAvailable" when the next data can be read; the value IRCOMM_PKT_START is reserved for packets
+ - reduced sensors frequency update: the proximity and ground sensors are sampled also during reception and transmission, one
+ sensor sample in place of a motor sample alternating proximity and ground. When receiving the proximity sensors are updated
+ every 40 ms and the ground sensors every 20 ms. When transmitting only the sensors not used by the transmission are sampled
+ (their pulse would be sent as data), while the transmission pulse is off: about 30 Hz for them (simulated in tests/testIrCodec,
+ without effect on the bit error rate). The sensors transmitting are updated by the sweep between two bytes (about 3 Hz); with
+ more than 4 sensors selected the two groups alternate at each byte, so each sensor is sampled at least every other byte.
+ The obstacle and cliff avoidance keep thus working; disable the interleave with "irCommProxEnabled=0" and
+ "irCommGroundEnabled=0" to get back the motors samples
+ - the data are sent using all the sensors by default, a subset of sensors can be selected with "irCommSetTxSensorMask". When more than
+ 4 sensors are used the data isn't sent contemporaneously from all of them, but the sensors are divided in two groups of alternating 
+ sensors; this is to reduce the istantaneous power consumption required by all the sensors.
  - maximum communication distance is about 5 cm
+ Before transmitting the robot checks that no neighbour is transmitting (the amplitude check used for reception),
+ otherwise the transmission is delayed by a random time that grows exponentially at each busy channel found.
+ With diversity combining enabled (frequency line code only) each bit is decided using all the sensors that perceive 
+ the signal instead of only the selected one; the signal strength perceived by each sensor is available in any case.
+ For debugging the reception can be captured through uart0 enabling the DEBUG_ flags in constants.h; each record has the format:
+ IRCOMM_CAPTURE_SYNC0, IRCOMM_CAPTURE_SYNC1, version, type, length (2 bytes), payload, CRC-8 (of version, type, length and payload).
+ All the 16 bits values are little endian. The payload of the window records (detection, start bit, data bit) contains:
+ time (lower 16 bits, 104 us units), line code, selected sensor, number of bits already received, amplitude (2 bytes), 
+ number of sensors (1 = only the selected sensor, 8 = all), samples (2 bytes each, IRCOMM_SAMPLING_WINDOW samples, when 
+ all the sensors are captured the 8 values of each sample are consecutive).
+ The payload of the byte records contains: time (2 bytes), selected sensor, byte, CRC error, confidence.
+ The host tool tests/irReplay decodes the data bit windows of a capture with irCommCodec and compares the bytes
+ with the byte records, for each line code, to evaluate changes to the decoding; the windows don't go through the
+ reception state machine of irCommTasks (the robot already synchronized them).
 
 */
 
 
 #include "variables.h"
 #include "utility.h"
+#include "irCommCodec.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,9 +72,11 @@ extern "C" {
 
 /**
  * \brief Initialize the IR communication; need to be called only once.
+ * \param lineCode line code used for the data bits: IRCOMM_CODE_FREQUENCY (compatible with previous firmwares)
+ * or IRCOMM_CODE_MANCHESTER (about twice faster); all the robots that communicate must use the same line code.
  * \return none
  */
-void irCommInit();
+void irCommInit(unsigned char lineCode);
 
 /**
  * \brief Initialize the IR communication state machine in reception mode (used internally).
@@ -73,15 +102,16 @@ void irCommDeinit();
  */
 void irCommTasks();
 
-///**
-// * \brief Set the data to be sent through IR; the obstacle avoidance and cliff avoidance will be disabled during the transmission.
-// * \param value: byte to be sent; sensor: sensor id mask (bit 0 corresponds to sensor 0 in front of robot, id increases clockwise).
-// * \return none
-// */
-//void irCommSendData(unsigned char value, unsigned char sensorMask);
+/**
+ * \brief Select the sensors used to send the data (bytes and packets); by default all the sensors are used.
+ * When more than 4 sensors are selected they are used in two alternating groups to limit the power consumption.
+ * \param sensorMask sensor id mask (bit 0 corresponds to sensor 0 in front of robot, id increases clockwise)
+ * \return none
+ */
+void irCommSetTxSensorMask(unsigned char sensorMask);
 
 /**
- * \brief Set the data to be sent through IR; the obstacle avoidance and cliff avoidance will be disabled during the transmission.
+ * \brief Set the data to be sent through IR; the obstacle and cliff avoidance keep working during the transmission if "irCommProxEnabled" and "irCommGroundEnabled" are set.
  * \param value: byte to be sent; sensor.
  * \return none
  */
@@ -105,6 +135,148 @@ unsigned char irCommDataAvailable();
  */
 unsigned char irCommReadData();
 
+/**
+ * \brief Extract the signal of one sensor from the current sampling window, remove its mean and add its power at
+ * the two bits frequencies to "irCommPowerBit0" and "irCommPowerBit1" (used internally).
+ * \param sensor sensor id (0..7)
+ * \return none
+ */
+void irCommRxAddSensorPower(unsigned char sensor);
+
+/**
+ * \brief Update the maximum signal amplitude perceived by each sensor during the current byte reception (used internally).
+ * \return none
+ */
+void irCommRxUpdateStrength();
+
+/**
+ * \brief Estimate the direction and distance of the sender of the last byte received from the signal strength of
+ * each sensor (used internally).
+ * \return none
+ */
+void irCommComputeRangeBearing();
+
+/**
+ * \brief Get the direction of the sender of the last byte received, interpolated between the sensor with the 
+ * strongest signal and its strongest adjacent sensor.
+ * \return the angle (-180..180), same reference as "getBearing"
+ */
+signed int irCommRxBearingEstimate();
+
+/**
+ * \brief Get the distance of the sender of the last byte received, estimated from the signal amplitude.
+ * \return the distance (mm)
+ */
+unsigned int irCommRxDistanceEstimate();
+
+/**
+ * \brief Save the current range and bearing estimate for a neighbour in the neighbours table; the neighbours 
+ * not perceived for IRCOMM_NEIGHBOUR_TIMEOUT are removed from the table. Only identified senders must be
+ * used (packets carry the sender id), single bytes may contain any data.
+ * \param id neighbour id (e.g. the sender of a packet)
+ * \return the index of the table entry used
+ */
+signed char irCommUpdateNeighbour(unsigned char id);
+
+/**
+ * \brief Get the signal strength perceived by a sensor during the reception of the last byte.
+ * \param sensor sensor id (0..7)
+ * \return the maximum amplitude of the signal (adc units), 0 if the sensor didn't perceive the message
+ */
+unsigned int irCommReceivingStrength(unsigned char sensor);
+
+/**
+ * \brief Start a capture record through uart0 (used internally); the record is terminated sending "irCommCaptureCrc".
+ * \param type record type (IRCOMM_CAPTURE_...)
+ * \param len payload length
+ * \return none
+ */
+void irCommCaptureStart(unsigned char type, unsigned int len);
+
+/**
+ * \brief Send a byte of the current capture record updating its CRC (used internally).
+ * \param value byte to send
+ * \return none
+ */
+void irCommCapturePut(unsigned char value);
+
+/**
+ * \brief Send the current sampling window through uart0 as a capture record (used internally, blocking).
+ * \param type record type (IRCOMM_CAPTURE_DETECTION, IRCOMM_CAPTURE_START_BIT, IRCOMM_CAPTURE_BIT)
+ * \param allSensors 1 to send the samples of all the sensors, 0 to send only the selected sensor
+ * \return none
+ */
+void irCommCaptureWindow(unsigned char type, unsigned char allSensors);
+
+/**
+ * \brief Send the result of the last byte reception through uart0 as a capture record (used internally, blocking).
+ * \return none
+ */
+void irCommCaptureByte();
+
+/**
+ * \brief Get the confidence of the last byte received, that is the lowest confidence of its bits given by the
+ * Goertzel detector (frequency line code) or the Manchester decoder.
+ * \return the confidence (0..100)
+ */
+unsigned char irCommReceivedConfidence();
+
+/**
+ * \brief Decode the two Manchester bits contained in the current sampling window (used internally).
+ * \return none
+ */
+void irCommRxReadManchesterBits();
+
+/**
+ * \brief Queue a packet to be sent through IR; the packet is sent as soon as the previous bytes are transmitted.
+ * \param data payload
+ * \param len payload length (1..IRCOMM_PKT_MAX_PAYLOAD)
+ * \return 1 if the packet is queued, 0 if the length is invalid or there isn't enough space in the tx queue
+ */
+unsigned char irCommSendPacket(unsigned char *data, unsigned char len);
+
+/**
+ * \brief Tell whether the tx queue is empty, that is all the packets are sent.
+ * \return 1 if the queue is empty, 0 otherwise
+ */
+unsigned char irCommTxQueueEmpty();
+
+/**
+ * \brief Tell whether there is at least one packet received.
+ * \return 1 if a packet is available, 0 otherwise
+ */
+unsigned char irCommPacketAvailable();
+
+/**
+ * \brief Get the oldest packet received, the packet is then removed from the rx queue.
+ * \param data buffer where the payload is saved (at least IRCOMM_PKT_MAX_PAYLOAD bytes)
+ * \param src sender id
+ * \param seq sequence number
+ * \param sensor sensor id that received the packet (0..7)
+ * \return the payload length, 0 if no packet is available
+ */
+unsigned char irCommReadPacket(unsigned char *data, unsigned char *src, unsigned char *seq, signed char *sensor);
+
+/**
+ * \brief Handle the reception of packets, called for each byte received (used internally).
+ * \param value byte received
+ * \return 1 if the byte is part of a packet, 0 otherwise
+ */
+unsigned char irCommRxPacketByte(unsigned char value);
+
+/**
+ * \brief Number of free bytes in the tx queue (used internally).
+ * \return free space
+ */
+unsigned char irCommTxQueueFree();
+
+/**
+ * \brief Add one byte to the tx queue without checking the free space (used internally).
+ * \param value byte to be queued
+ * \return none
+ */
+void irCommTxQueuePut(unsigned char value);
+
 /**
  * \brief Get the last sensor id that receives the message.
  * \return the sensor id (0..7); 0 is the front sensor, sensors id increases clockwise
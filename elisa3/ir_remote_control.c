@@ -193,14 +193,9 @@ void handleIRRemoteCommands() {
 				case 51:
 					pwm_right_desired = 0;
 					pwm_left_desired = 0;
-					if(currentSelector == 8) {
-						calibrateSensors();
-						proximityResult[8] = 1023;	// because the first time this value could be low after calibration
-						proximityResult[11] = 1023;	// and in that case a false black line will be detected
-						calibState = CALIBRATION_STATE_FIND_THRS_0;
-						calibVelIndex = 1;
-						calibrateOdomFlag = 1;
-
+					if((currentSelector == 8) && (calibrationState == SENS_CALIB_STATE_IDLE)) {
+						calibrationNext = SENS_CALIB_NEXT_ODOM_CALIB;	// the odometry calibration starts when the sensors are calibrated
+						calibrateSensorsStart();
 					}
 					break;
 
@@ -0,0 +1,146 @@
+
+#include "logger.h"
+
+volatile signed int *logChannelAddress(signed int ch) {
+	if(ch < 24) {
+		return (volatile signed int*)&proximityValue[ch];
+	} else if(ch < 36) {
+		return (volatile signed int*)&proximityResult[ch-24];
+	}
+	switch(ch) {
+		case 36:
+			return &last_left_vel;
+		case 37:
+			return &last_right_vel;
+		case 38:
+			return &pwm_left;
+		case 39:
+			return &pwm_right;
+		case 40:
+			return &accX;
+		case 41:
+			return &accY;
+		case 42:
+			return &accZ;
+	}
+	return 0;
+}
+
+void logStart(signed int *channels, unsigned char len, unsigned int decimation, signed char trigChannel, signed int trigLevel, unsigned int pretrigger) {
+	unsigned char i = 0;
+
+	logState = LOG_IDLE;		// the interrupt doesn't touch the buffer while configuring
+
+	logNumCh = 0;
+	for(i=0; i<len && logNumCh<LOG_MAX_CHANNELS; i++) {
+		if(channels[i]<0 || channels[i]>=LOG_CHANNELS_NUM) {
+			continue;
+		}
+		logSource[logNumCh] = logChannelAddress(channels[i]);
+		logNumCh++;
+	}
+	if(logNumCh == 0) {
+		return;
+	}
+
+	logCapacity = LOG_BUFF_WORDS/logNumCh;
+	logDecimation = (decimation==0)?1:decimation;
+	logDecimCounter = 0;
+	logHead = 0;
+	logCount = 0;
+	logPretrigger = (pretrigger>=logCapacity)?(logCapacity-1):pretrigger;
+	logRemaining = logCapacity - logPretrigger;
+	logTrigLevel = trigLevel;
+	logTrigFirst = 1;
+
+	if(trigChannel<0 || trigChannel>=logNumCh) {
+		logTrigChannel = -1;
+		logRemaining = logCapacity;
+		logState = LOG_TRIGGERED;
+	} else {
+		logTrigChannel = trigChannel;
+		logState = LOG_WAIT_TRIGGER;
+	}
+}
+
+void logStop() {
+	if(logState==LOG_WAIT_TRIGGER || logState==LOG_TRIGGERED) {
+		logState = LOG_IDLE;
+	}
+}
+
+void logSample() {
+	unsigned char i = 0;
+	signed int value = 0;
+	signed int *frame;
+
+	if(logState!=LOG_WAIT_TRIGGER && logState!=LOG_TRIGGERED) {
+		return;
+	}
+	logDecimCounter++;
+	if(logDecimCounter < logDecimation) {
+		return;
+	}
+	logDecimCounter = 0;
+
+	frame = &logBuffer[logHead*logNumCh];
+	for(i=0; i<logNumCh; i++) {
+		frame[i] = *logSource[i];
+	}
+	logHead++;
+	if(logHead >= logCapacity) {
+		logHead = 0;
+	}
+	if(logCount < logCapacity) {
+		logCount++;
+	}
+
+	if(logState == LOG_WAIT_TRIGGER) {
+		value = frame[logTrigChannel];
+		if(logTrigFirst) {		// no previous sample to compare with
+			logTrigFirst = 0;
+		} else if(logTrigPrev<logTrigLevel && value>=logTrigLevel) {
+			logState = LOG_TRIGGERED;
+		}
+		logTrigPrev = value;
+		if(logState == LOG_WAIT_TRIGGER) {
+			return;
+		}
+	}
+
+	logRemaining--;				// the trigger frame is the first one counted
+	if(logRemaining == 0) {
+		logState = LOG_DONE;
+	}
+}
+
+unsigned int logGetFrames() {
+	return logCount;
+}
+
+unsigned int logReadFrames(unsigned int first, unsigned int num, signed int *dest) {
+	unsigned int f = 0, index = 0, n = 0;
+	unsigned char i = 0;
+
+	if(logState==LOG_WAIT_TRIGGER || logState==LOG_TRIGGERED) {
+		return 0;
+	}
+	if(first >= logCount) {
+		return 0;
+	}
+	if(num > (logCount-first)) {
+		num = logCount-first;
+	}
+
+	index = logHead + logCapacity - logCount + first;	// oldest frame is logCount frames before the head
+	for(f=0; f<num; f++) {
+		if(index >= logCapacity) {
+			index -= logCapacity;
+		}
+		for(i=0; i<logNumCh; i++) {
+			dest[n++] = logBuffer[index*logNumCh+i];
+		}
+		index++;
+	}
+	return num;
+}
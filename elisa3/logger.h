@@ -0,0 +1,79 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+
+/**
+ * \file logger.h
+ * \brief High rate sensors logger
+ * \author Stefano Morgani <stefano@gctronic.com>
+ * \version 1.0
+ * \date 19.10.26
+ * \copyright GNU GPL v3
+
+ The module records up to LOG_MAX_CHANNELS signals in a ring buffer in RAM. The sampling is done
+ in the adc interrupt (104 us) divided by the decimation factor, thus a decimation of 10 gives about 1 KHz.
+ The recording can start immediately or wait for a trigger: the selected channel crossing the level
+ upward. The buffer keeps always the last frames (one sample for each channel) so that the frames
+ before the trigger are available (pretrigger); after the trigger the recording continues until the
+ buffer is filled and then stops (LOG_DONE). The content of the buffer is sent to the computer only
+ when requested, thus the recording doesn't add any communication during the run.
+
+ Channels:
+ - 0..23: proximityValue (raw adc values, ambient and reflected for each sensor)
+ - 24..35: proximityResult
+ - 36, 37: left and right measured speed
+ - 38, 39: left and right pwm
+ - 40..42: accelerometer x, y, z
+*/
+
+
+#include "variables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Configure the logger and start the recording; the data previously recorded are lost.
+ * \param channels list of the channels to record (see the channels list above), negative values are skipped
+ * \param len number of elements in the list (at most LOG_MAX_CHANNELS are used)
+ * \param decimation one sample every "decimation" adc interrupts (at least 1)
+ * \param trigChannel position of the trigger channel in the list, negative to start recording immediately
+ * \param trigLevel trigger level
+ * \param pretrigger number of frames to keep before the trigger
+ * \return none
+ */
+void logStart(signed int *channels, unsigned char len, unsigned int decimation, signed char trigChannel, signed int trigLevel, unsigned int pretrigger);
+
+/**
+ * \brief Stop the recording, the data recorded until now are kept.
+ * \return none
+ */
+void logStop();
+
+/**
+ * \brief Take the samples of the selected channels; called from the adc interrupt.
+ * \return none
+ */
+void logSample();
+
+/**
+ * \brief Return the number of frames available in the buffer.
+ * \return frames number
+ */
+unsigned int logGetFrames();
+
+/**
+ * \brief Copy the samples of some frames in chronological order (0 = oldest frame); the logger must be stopped.
+ * \param first index of the first frame to copy
+ * \param num number of frames to copy
+ * \param dest destination of the samples, it must have space for num*logNumCh values
+ * \return number of frames copied
+ */
+unsigned int logReadFrames(unsigned int first, unsigned int num, signed int *dest);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -25,6 +25,7 @@
 */
 
 #include "mirf.h"
+#include "rfAseba.h"
 #include "nRF24L01.h"
 #include "spi.h"
 #include <avr/io.h>
@@ -74,11 +75,17 @@ void mirf_config()
 	// rx address => same as tx address for auto ack
 	mirf_write_register(RX_ADDR_P0, temp, 3);
 
-	// enable auto ack for pipe0
+	// broadcast address for pipe1
+	temp[0] = RF_BROADCAST_ADDR0;
+	temp[1] = RF_BROADCAST_ADDR1;
+	temp[2] = RF_BROADCAST_ADDR2;
+	mirf_write_register(RX_ADDR_P1, temp, 3);
+
+	// enable auto ack for pipe0 (the broadcast pipe1 is without ack, the commands are received by many robots)
 	mirf_config_register(EN_AA, 0x01);
 
-	// enable pipe0
-	mirf_config_register(EN_RXADDR, 0x01);
+	// enable pipe0 and pipe1
+	mirf_config_register(EN_RXADDR, 0x03);
 
 	// 500s (+ 86s on-air), 2 re-transmissions
 	mirf_config_register(SETUP_RETR, 0x12);
@@ -89,6 +96,9 @@ void mirf_config()
 	// RX payload size; it isn't needed because the dynamic payload length is activated for ACK+PAYLOAD feature
     mirf_config_register(RX_PW_P0, PAYLOAD_SIZE);
 
+	// pipe1 payload size (fixed, the dynamic payload length requires the auto ack)
+    mirf_config_register(RX_PW_P1, PAYLOAD_SIZE);
+
 	// enable extra features
     mirf_CSN_lo;
     SPI_Write_Byte(NRF_ACTIVATE);
@@ -166,13 +176,21 @@ uint8_t mirf_data_ready()
 
 }
 
+uint8_t mirf_read_status() {
+    uint8_t status;
+    mirf_CSN_lo;
+    status = SPI_Write_Byte(NOP);
+    mirf_CSN_hi;
+    return status;
+}
+
 uint8_t rx_fifo_is_empty() {
 	
 	uint8_t fifo_status = 0;
 
 	mirf_read_register(FIFO_STATUS, &fifo_status, 1);
 	
-	return (uint8_t)(fifo_status&0x01);
+	return (uint8_t)((fifo_status>>RX_EMPTY)&0x01);
 }
 
 void flush_rx_fifo() {
@@ -293,7 +311,7 @@ void flushTxFifo() {
 
 void handleRFCommands() {
 
-	unsigned int i=0;
+	uint8_t pipe = 0;
 	//uint8_t pWidth = 0;
 	//uint8_t pWidthP0 = 0;
 
@@ -315,302 +333,451 @@ void handleRFCommands() {
 		// sure there are correct data to be read.
 		// We don't know why the IRQ for data reception is raised, maybe is not correctly reset sometimes
 		// or it is raised when it shouldn't...
-		if(rx_fifo_is_empty()) {
-			return;
-		}
+		// The fifo is then read until it is empty (instead of flushing it after the first packet), so that the
+		// packets received meanwhile aren't lost.
+		while(rx_fifo_is_empty() == 0) {
+			pipe = (mirf_read_status()>>RX_P_NO)&0x07;	// pipe of the data on top of the fifo
+
+			/*		
+			pWidth = readPayloadWidthFromTopFifo();
+			if(pWidth != 13) {	// discard the data if the expected payload size isn't correct
+				usart0Transmit(pWidth, 1);
+				return;
+			}
+			if(pWidth > 32) {	// from the datasheet if the payload is > 32 then the fifo should be flushed and the packet discarded
+				flush_rx_fifo();
+				return;
+			}
+			//usart0Transmit(pWidth, 1);
+			pWidthP0 = readPayloadWidthFromPipe0();
+			//usart0Transmit(pWidthP0, 1);
+			if(pWidthP0 != 13) {
+				usart0Transmit(pWidthP0, 1);
+			}
+			*/
 
-		/*		
-		pWidth = readPayloadWidthFromTopFifo();
-		if(pWidth != 13) {	// discard the data if the expected payload size isn't correct
-			usart0Transmit(pWidth, 1);
-			return;
+			mirf_get_data(rfData);
+			handleRFPacket(pipe);
 		}
-		if(pWidth > 32) {	// from the datasheet if the payload is > 32 then the fifo should be flushed and the packet discarded
-			flush_rx_fifo();
-			return;
-		}
-		//usart0Transmit(pWidth, 1);
-		pWidthP0 = readPayloadWidthFromPipe0();
-		//usart0Transmit(pWidthP0, 1);
-		if(pWidthP0 != 13) {
-			usart0Transmit(pWidthP0, 1);
+
+	}
+
+}
+
+void handleRFPacket(uint8_t pipe) {
+
+	unsigned int i=0;
+
+	if(pipe == RF_BROADCAST_PIPE) {	// broadcast data are only commands for the group, there is no ack payload
+		if(rfData[0] == RF_GROUP_CMD) {
+			handleGroupCommand(rfData);
+		} else if(rfData[0] == RF_TIME_BEACON) {
+			handleTimeBeacon(rfData);
 		}
-		*/
+		return;
+	}
 
-		mirf_get_data(rfData);
-		flush_rx_fifo();
+	if(rfAsebaIsFrame(rfData)) {	// fragment of an Aseba message, not a command
+		rfAsebaHandleFrame(rfData);
+		return;
+	}
 
-		//usartTransmit(rfData[0]);
+	if(rfData[0] == RF_ACK_SCHEDULE_CMD) {	// new schedule of the packets sent back, not a command
+		setAckSchedule(&rfData[2], rfData[1]);
+		fillAckPayload();
+		writeAckPayload(ackPayload, 16);
+		return;
+	}
 
-		if(rfDebugMode==1) {
+	// poll packet or robot controlled by the Aseba script: only send back the sensors
+	if((rfData[0] == RF_POLL_CMD) || (rfLegacyCommandsEnabled==0 && rfDebugMode==0)) {
+		fillAckPayload();
+		writeAckPayload(ackPayload, 16);
+		return;
+	}
 
-			writeAckPayload(ackPayload, 16);
-			
-		} else {
+	//usartTransmit(rfData[0]);
+
+	if(rfDebugMode==1) {
+
+		writeAckPayload(ackPayload, 16);
+		
+	} else {
+
+		//if((data[3]&0b00001000)==0b00001000) {	// check the 4th bit to sleep
+		// it was noticed that some robots sometimes "think" to receive something and the data read are wrong,
+		// this could lead to go to sleep involuntarily; in order to avoid this situation we define that the
+		// sleep message should be completely zero, but the flag bit
+		if(rfData[0]==0 && rfData[1]==0 && rfData[2]==0 && rfData[3]==0b00001000 && rfData[4]==0 && rfData[5]==0) {
+
+			sleep(60);
 
-			//if((data[3]&0b00001000)==0b00001000) {	// check the 4th bit to sleep
-			// it was noticed that some robots sometimes "think" to receive something and the data read are wrong,
-			// this could lead to go to sleep involuntarily; in order to avoid this situation we define that the
-			// sleep message should be completely zero, but the flag bit
-			if(rfData[0]==0 && rfData[1]==0 && rfData[2]==0 && rfData[3]==0b00001000 && rfData[4]==0 && rfData[5]==0) {
+		}
+
+		if(calibrateOdomFlag==0) { 
+			speedr = (rfData[4]&0x7F);	// cast the speed to be at most 127, thus the received speed are in the range 0..127 (usually 0..100),
+			speedl = (rfData[5]&0x7F);	// the received speed is then shifted by 3 (x8) in order to have a speed more or less
+										// in the same range of the measured speed that is 0..800.
+										// In order to have greater resolution at lower speed we shift the speed only by 2 (x4),
+										// this means that the range is more or less 0..400.
 
-				sleep(60);
 
+			if((rfData[4]&0x80)==0x80) {			// motor right forward
+				pwm_right_desired = speedr; 		// speed received (0..127) is expressed in 1/5 of mm/s (0..635 mm/s)
+			} else {								// backward
+				pwm_right_desired = -(speedr);
 			}
 
-			if(calibrateOdomFlag==0) { 
-				speedr = (rfData[4]&0x7F);	// cast the speed to be at most 127, thus the received speed are in the range 0..127 (usually 0..100),
-				speedl = (rfData[5]&0x7F);	// the received speed is then shifted by 3 (x8) in order to have a speed more or less
-											// in the same range of the measured speed that is 0..800.
-											// In order to have greater resolution at lower speed we shift the speed only by 2 (x4),
-											// this means that the range is more or less 0..400.
+			if((rfData[5]&0x80)==0x80) {			// motor left forward
+				pwm_left_desired = speedl;
+			} else {								// backward
+				pwm_left_desired = -(speedl);
+			}
 
+		}
 
-				if((rfData[4]&0x80)==0x80) {			// motor right forward
-					pwm_right_desired = speedr; 		// speed received (0..127) is expressed in 1/5 of mm/s (0..635 mm/s)
-				} else {								// backward
-					pwm_right_desired = -(speedr);
-				}
 
-				if((rfData[5]&0x80)==0x80) {			// motor left forward
-					pwm_left_desired = speedl;
-				} else {								// backward
-					pwm_left_desired = -(speedl);
-				}
+		for(i=0; i<3; i++) {
+			dataLED[i]=rfData[i]&0xFF;
+		}
+		pwm_red = MAX_LEDS_PWM-MAX_LEDS_PWM*(dataLED[0]&0xFF)/100;
+		pwm_blue = MAX_LEDS_PWM-MAX_LEDS_PWM*(dataLED[1]&0xFF)/100;
+		pwm_green = MAX_LEDS_PWM-MAX_LEDS_PWM*(dataLED[2]&0xFF)/100;
+		updateRedLed(pwm_red);
+		updateGreenLed(pwm_green);
+		updateBlueLed(pwm_blue);
 
-			}
 
+		if((rfData[3]&0b00000001)==0b00000001) {	// turn on back IR
+			LED_IR1_LOW;
+		} else {
+			LED_IR1_HIGH;
+		}
 
-			for(i=0; i<3; i++) {
-				dataLED[i]=rfData[i]&0xFF;
-			}
-			pwm_red = MAX_LEDS_PWM-MAX_LEDS_PWM*(dataLED[0]&0xFF)/100;
-			pwm_blue = MAX_LEDS_PWM-MAX_LEDS_PWM*(dataLED[1]&0xFF)/100;
-			pwm_green = MAX_LEDS_PWM-MAX_LEDS_PWM*(dataLED[2]&0xFF)/100;
-			updateRedLed(pwm_red);
-			updateGreenLed(pwm_green);
-			updateBlueLed(pwm_blue);
+		if((rfData[3]&0b00000010)==0b00000010) {	// turn on front IRs
+			LED_IR2_LOW;
+		} else {
+			LED_IR2_HIGH;
+		}
+
+		if((rfData[3]&0b00000100)==0b00000100) {	// check the 3rd bit to enable/disable the IR receiving
+			irEnabled = 1;
+		} else {
+			irEnabled = 0;
+		}
+
+		if(((rfData[3]&0b00010000)==0b00010000) && (calibrationState==SENS_CALIB_STATE_IDLE)) {	// check the 5th bit to start calibration of all sensors
+			calibrationNext = SENS_CALIB_NEXT_RESET_ODOM;	// the calibration is carried out by "calibrateSensorsTask"
+			calibrateSensorsStart();
+		}
 
+		if((rfData[3]&0b01000000)==0b01000000) {	// check the seventh bit to enable/disable obstacle avoidance
+			obstacleAvoidanceEnabled = 1;
+		} else {
+			obstacleAvoidanceEnabled = 0;
+		}
 
-			if((rfData[3]&0b00000001)==0b00000001) {	// turn on back IR
-				LED_IR1_LOW;
+		if((rfData[3]&0b10000000)==0b10000000) {	// check the eight bit to enable/disable obstacle avoidance
+			cliffAvoidanceEnabled = 1;
+		} else {
+			cliffAvoidanceEnabled = 0;
+		}
+
+		// handle small green leds
+		#ifdef HW_REV_3_1			
+
+			if(bit_is_set(rfData[6], 0) ) {
+				GREEN_LED0_ON;
 			} else {
-				LED_IR1_HIGH;
+				GREEN_LED0_OFF;
 			}
-
-			if((rfData[3]&0b00000010)==0b00000010) {	// turn on front IRs
-				LED_IR2_LOW;
+			
+			if(bit_is_set(rfData[6], 1) ) {
+				GREEN_LED1_ON;
 			} else {
-				LED_IR2_HIGH;
+				GREEN_LED1_OFF;
 			}
+			
+			if(bit_is_set(rfData[6], 2) ) {
+				GREEN_LED2_ON;
+			} else {
+				GREEN_LED2_OFF;
+			}												
 
-			if((rfData[3]&0b00000100)==0b00000100) {	// check the 3rd bit to enable/disable the IR receiving
-				irEnabled = 1;
+			if(bit_is_set(rfData[6], 3) ) {
+				GREEN_LED3_ON;
 			} else {
-				irEnabled = 0;
+				GREEN_LED3_OFF;
 			}
 
-			if((rfData[3]&0b00010000)==0b00010000) {	// check the 5th bit to start calibration of all sensors
-				calibrateSensors();
-				resetOdometry();
+			if(bit_is_set(rfData[6], 4) ) {
+				GREEN_LED4_ON;
+			} else {
+				GREEN_LED4_OFF;
 			}
 
-			if((rfData[3]&0b01000000)==0b01000000) {	// check the seventh bit to enable/disable obstacle avoidance
-				obstacleAvoidanceEnabled = 1;
+			if(bit_is_set(rfData[6], 5) ) {
+				GREEN_LED5_ON;
 			} else {
-				obstacleAvoidanceEnabled = 0;
+				GREEN_LED5_OFF;
 			}
 
-			if((rfData[3]&0b10000000)==0b10000000) {	// check the eight bit to enable/disable obstacle avoidance
-				cliffAvoidanceEnabled = 1;
+			if(bit_is_set(rfData[6], 6) ) {
+				GREEN_LED6_ON;
 			} else {
-				cliffAvoidanceEnabled = 0;
+				GREEN_LED6_OFF;
 			}
 
-			// handle small green leds
-			#ifdef HW_REV_3_1			
+			if(bit_is_set(rfData[6], 7) ) {
+				GREEN_LED7_ON;
+			} else {
+				GREEN_LED7_OFF;
+			}
 
-				if(bit_is_set(rfData[6], 0) ) {
-					GREEN_LED0_ON;
-				} else {
-					GREEN_LED0_OFF;
-				}
-				
-				if(bit_is_set(rfData[6], 1) ) {
-					GREEN_LED1_ON;
-				} else {
-					GREEN_LED1_OFF;
-				}
-				
-				if(bit_is_set(rfData[6], 2) ) {
-					GREEN_LED2_ON;
-				} else {
-					GREEN_LED2_OFF;
-				}												
-
-				if(bit_is_set(rfData[6], 3) ) {
-					GREEN_LED3_ON;
-				} else {
-					GREEN_LED3_OFF;
+		#endif
+	
+		if(currentSelector == 8) {
+			if(calibrateOdomFlag==0) {
+				if(((rfData[7]&0b00000001)==0b00000001) && (calibrationState==SENS_CALIB_STATE_IDLE)) {
+					calibrationNext = SENS_CALIB_NEXT_ODOM_CALIB;	// the odometry calibration starts when the sensors are calibrated
+					calibrateSensorsStart();
 				}
+			}
+		}
 
-				if(bit_is_set(rfData[6], 4) ) {
-					GREEN_LED4_ON;
-				} else {
-					GREEN_LED4_OFF;
-				}
+		// read and handle the remaining bytes of the payload (at the moment not used)
 
-				if(bit_is_set(rfData[6], 5) ) {
-					GREEN_LED5_ON;
-				} else {
-					GREEN_LED5_OFF;
-				}
 
-				if(bit_is_set(rfData[6], 6) ) {
-					GREEN_LED6_ON;
-				} else {
-					GREEN_LED6_OFF;
-				}
+		// write back the ack payload
+		fillAckPayload();
+		writeAckPayload(ackPayload, 16);
 
-				if(bit_is_set(rfData[6], 7) ) {
-					GREEN_LED7_ON;
-				} else {
-					GREEN_LED7_OFF;
-				}
-
-			#endif
-		
-			if(currentSelector == 8) {
-				if(calibrateOdomFlag==0) {
-					if((rfData[7]&0b00000001)==0b00000001) {
-						calibrateSensors();
-						proximityResult[8] = 1023;	// because the first time this value could be low after calibration
-						proximityResult[11] = 1023;	// and in that case a false black line will be detected
-						calibState = CALIBRATION_STATE_FIND_THRS_0;
-						calibVelIndex = 1;
-						calibrateOdomFlag = 1;
-					}
-				}
-			}
+	}
 
-			// read and handle the remaining bytes of the payload (at the moment not used)
-
-
-			// write back the ack payload
-			ackPayload[0] = packetId&0xFF;
-
-			switch(packetId) {
-				case 3:
-					ackPayload[1] = proximityResult[0]&0xFF;
-					ackPayload[2] = proximityResult[0]>>8;
-					ackPayload[3] = proximityResult[1]&0xFF;
-					ackPayload[4] = proximityResult[1]>>8;
-					ackPayload[5] = proximityResult[2]&0xFF;
-					ackPayload[6] = proximityResult[2]>>8;
-					ackPayload[7] = proximityResult[3]&0xFF;
-					ackPayload[8] = proximityResult[3]>>8;
-					ackPayload[9] = proximityResult[5]&0xFF;
-					ackPayload[10] = proximityResult[5]>>8;
-					ackPayload[11] = proximityResult[6]&0xFF;
-					ackPayload[12] = proximityResult[6]>>8;
-					ackPayload[13] = proximityResult[7]&0xFF;
-					ackPayload[14] = proximityResult[7]>>8;
-					#ifdef HW_REV_3_1
-						ackPayload[15] = CHARGE_ON | (BUTTON0 << 1) | (CHARGE_STAT << 2);
-					#else
-						ackPayload[15] = CHARGE_ON | (BUTTON0 << 1);
-					#endif
-					packetId = 4;
-					break;
-
-				case 4:
-					ackPayload[1] = proximityResult[4]&0xFF;
-					ackPayload[2] = proximityResult[4]>>8;
-					ackPayload[3] = proximityResult[8]&0xFF;
-					ackPayload[4] = proximityResult[8]>>8;
-					ackPayload[5] = proximityResult[9]&0xFF;
-					ackPayload[6] = proximityResult[9]>>8;
-					ackPayload[7] = proximityResult[10]&0xFF;
-					ackPayload[8] = proximityResult[10]>>8;
-					ackPayload[9] = proximityResult[11]&0xFF;
-					ackPayload[10] = proximityResult[11]>>8;
-					ackPayload[11] = accX&0xFF;
-					ackPayload[12] = accX>>8;
-					ackPayload[13] = accY&0xFF;
-					ackPayload[14] = accY>>8;
-					ackPayload[15] = irCommand;
-					packetId = 5;
-					break;
-
-				case 5:
-					ackPayload[1] = proximityValue[0]&0xFF;
-					ackPayload[2] = proximityValue[0]>>8;
-					ackPayload[3] = proximityValue[2]&0xFF;
-					ackPayload[4] = proximityValue[2]>>8;
-					ackPayload[5] = proximityValue[4]&0xFF;
-					ackPayload[6] = proximityValue[4]>>8;
-					ackPayload[7] = proximityValue[6]&0xFF;
-					ackPayload[8] = proximityValue[6]>>8;
-					ackPayload[9] = proximityValue[10]&0xFF;
-					ackPayload[10] = proximityValue[10]>>8;
-					ackPayload[11] = proximityValue[12]&0xFF;
-					ackPayload[12] = proximityValue[12]>>8;
-					ackPayload[13] = proximityValue[14]&0xFF;
-					ackPayload[14] = proximityValue[14]>>8;
-					ackPayload[15] = currentSelector;
-					packetId = 6;
-					break;
-
-				case 6:
-					ackPayload[1] = proximityValue[8]&0xFF;
-					ackPayload[2] = proximityValue[8]>>8;
-					ackPayload[3] = proximityValue[16]&0xFF;
-					ackPayload[4] = proximityValue[16]>>8;
-					ackPayload[5] = proximityValue[18]&0xFF;
-					ackPayload[6] = proximityValue[18]>>8;
-					ackPayload[7] = proximityValue[20]&0xFF;
-					ackPayload[8] = proximityValue[20]>>8;
-					ackPayload[9] = proximityValue[22]&0xFF;
-					ackPayload[10] = proximityValue[22]>>8;
-					ackPayload[11] = accZ&0xFF;
-					ackPayload[12] = accZ>>8;	
-					ackPayload[13] = batteryLevel&0xFF;
-					ackPayload[14] = batteryLevel>>8;
-					ackPayload[15] = 0;
-					packetId = 7;
-					break;
-
-
-				case 7:
-					ackPayload[1] = ((signed long int)leftMotSteps)&0xFF;
-					ackPayload[2] = ((signed long int)leftMotSteps)>>8;
-					ackPayload[3] = ((signed long int)leftMotSteps)>>16;
-					ackPayload[4] = ((signed long int)leftMotSteps)>>24;
-					ackPayload[5] = ((signed long int)rightMotSteps)&0xFF;
-					ackPayload[6] = ((signed long int)rightMotSteps)>>8;
-					ackPayload[7] = ((signed long int)rightMotSteps)>>16;
-					ackPayload[8] = ((signed long int)rightMotSteps)>>24;
-					lastTheta = theta;
-					ackPayload[9] = ((signed int)(lastTheta*573.0))&0xFF;	// radians to degrees => 573 = 1800/PI
-					ackPayload[10] = ((signed int)(lastTheta*573.0))>>8;				
-					ackPayload[11] = ((unsigned int)xPos)&0xFF;
-					ackPayload[12] = ((unsigned int)xPos)>>8;
-					ackPayload[13] = ((unsigned int)yPos)&0xFF;
-					ackPayload[14] = ((unsigned int)yPos)>>8;
-					ackPayload[15] = 0;
-					packetId = 3;
-					break;
+}
 
-			}
+void handleGroupCommand(unsigned char *data) {
+	unsigned long int delay = 0;
 
-			writeAckPayload(ackPayload, 16);
+	if((data[1] != RF_GROUP_ALL) && (data[1] != rfGroupId)) {
+		return;
+	}
+	if(data[3] == rfGroupCmdSeq) {	// the command is repeated to reach all the robots, execute it once
+		return;
+	}
+	rfGroupCmdSeq = data[3];
+	rfGroupCmdType = data[2]&(~RF_GROUP_AT_TIME);
+	rfGroupCmdIndex = data[8];
+	rfGroupCmdValue = (signed int)(data[9] | (data[10]<<8));
+	delay = (unsigned long int)data[4] | ((unsigned long int)data[5]<<8) | ((unsigned long int)data[6]<<16) | ((unsigned long int)data[7]<<24);
+	if(data[2] & RF_GROUP_AT_TIME) {	// absolute global time
+		rfGroupCmdTime = delay;
+	} else {
+		// the delay (104 us units) is counted from the reception; the computer reduces the delay of the repeated
+		// commands by the time elapsed since the first one, so that all the robots execute it at the same time
+		rfGroupCmdTime = getGlobalTime() + delay;
+	}
+	rfGroupCmdPending = 1;	// a new command replaces the one pending
+}
 
+void handleTimeBeacon(unsigned char *data) {
+	unsigned long int master = (unsigned long int)data[1] | ((unsigned long int)data[2]<<8) | ((unsigned long int)data[3]<<16) | ((unsigned long int)data[4]<<24);
+	unsigned long int local = rfDataReadyTime;	// all the robots receive the beacon at the same time
+	unsigned long int deltaLocal = local - rfTimeLastLocal;
+	signed long int deltaDiff = (signed long int)((master - rfTimeLastMaster) - deltaLocal);
+	signed long int drift = 0;
+
+	if(rfTimeSyncState == RF_TIME_NOT_SYNC) {
+		rfTimeSyncState = RF_TIME_OFFSET_SYNC;
+	} else if((deltaLocal >= RF_TIME_MIN_INTERVAL) && (deltaLocal <= RF_TIME_MAX_INTERVAL) && (labs(deltaDiff) < (signed long int)(deltaLocal>>4))) {
+		drift = (deltaDiff<<16) / (signed long int)deltaLocal;
+		if(rfTimeSyncState == RF_TIME_OFFSET_SYNC) {
+			rfTimeDriftQ16 = drift;
+			rfTimeSyncState = RF_TIME_DRIFT_SYNC;
+		} else {
+			rfTimeDriftQ16 += (drift - rfTimeDriftQ16)>>2;	// filter the jitter of the reception time
 		}
+	}
+	rfTimeOffset = (signed long int)(master - local);
+	rfTimeLastLocal = local;
+	rfTimeLastMaster = master;
+}
 
-		
+unsigned char rfGroupCommandDue() {
+	if(rfGroupCmdPending && ((signed long int)(getGlobalTime()-rfGroupCmdTime) >= 0)) {
+		rfGroupCmdPending = 0;
+		return 1;
+	}
+	return 0;
+}
+
+void rfStartStatusPoll() {
+	if((rfPollEnabled==0) || (rfPollBusy==1)) {
+		return;
+	}
+	rfPollBusy = 1;
+	mirf_CSN_lo;
+	SPCR |= (1<<SPIE);	// the transfer is completed in the spi interrupt
+	SPDR = NOP;			// read the status register
+}
+
+ISR(SPI_STC_vect) {
+	uint8_t status = SPDR;
+	mirf_CSN_hi;
+	SPCR &= ~(1<<SPIE);
+	if((status & (1<<RX_DR)) && (rfDataReady==0)) {
+		rfDataReady = 1;
+		rfDataReadyTime = clockTick;	// reception time used for the time synchronization
+	}
+	rfPollBusy = 0;
+}
+
+void rfTasks() {
+	if(rfDataReady == 0) {
+		return;
+	}
+	rfDataReady = 0;
+	rfPollEnabled = 0;	// the spi is used by the main loop, stop the background status read
+	while(rfPollBusy);
+	handleRFCommands();
+	rfPollEnabled = 1;
+}
 
+void fillAckPayload() {
+
+	packetId = rfAckSchedule[rfAckScheduleIndex];	// next packet of the schedule
+	rfAckScheduleIndex++;
+	if(rfAckScheduleIndex >= rfAckScheduleLen) {
+		rfAckScheduleIndex = 0;
 	}
 
+	ackPayload[0] = packetId&0xFF;
+
+	switch(packetId) {
+		case 3:
+			ackPayload[1] = proximityResult[0]&0xFF;
+			ackPayload[2] = proximityResult[0]>>8;
+			ackPayload[3] = proximityResult[1]&0xFF;
+			ackPayload[4] = proximityResult[1]>>8;
+			ackPayload[5] = proximityResult[2]&0xFF;
+			ackPayload[6] = proximityResult[2]>>8;
+			ackPayload[7] = proximityResult[3]&0xFF;
+			ackPayload[8] = proximityResult[3]>>8;
+			ackPayload[9] = proximityResult[5]&0xFF;
+			ackPayload[10] = proximityResult[5]>>8;
+			ackPayload[11] = proximityResult[6]&0xFF;
+			ackPayload[12] = proximityResult[6]>>8;
+			ackPayload[13] = proximityResult[7]&0xFF;
+			ackPayload[14] = proximityResult[7]>>8;
+			#ifdef HW_REV_3_1
+				ackPayload[15] = CHARGE_ON | (BUTTON0 << 1) | (CHARGE_STAT << 2);
+			#else
+				ackPayload[15] = CHARGE_ON | (BUTTON0 << 1);
+			#endif
+			break;
+
+		case 4:
+			ackPayload[1] = proximityResult[4]&0xFF;
+			ackPayload[2] = proximityResult[4]>>8;
+			ackPayload[3] = proximityResult[8]&0xFF;
+			ackPayload[4] = proximityResult[8]>>8;
+			ackPayload[5] = proximityResult[9]&0xFF;
+			ackPayload[6] = proximityResult[9]>>8;
+			ackPayload[7] = proximityResult[10]&0xFF;
+			ackPayload[8] = proximityResult[10]>>8;
+			ackPayload[9] = proximityResult[11]&0xFF;
+			ackPayload[10] = proximityResult[11]>>8;
+			ackPayload[11] = accX&0xFF;
+			ackPayload[12] = accX>>8;
+			ackPayload[13] = accY&0xFF;
+			ackPayload[14] = accY>>8;
+			ackPayload[15] = irCommand;
+			break;
+
+		case 5:
+			ackPayload[1] = proximityValue[0]&0xFF;
+			ackPayload[2] = proximityValue[0]>>8;
+			ackPayload[3] = proximityValue[2]&0xFF;
+			ackPayload[4] = proximityValue[2]>>8;
+			ackPayload[5] = proximityValue[4]&0xFF;
+			ackPayload[6] = proximityValue[4]>>8;
+			ackPayload[7] = proximityValue[6]&0xFF;
+			ackPayload[8] = proximityValue[6]>>8;
+			ackPayload[9] = proximityValue[10]&0xFF;
+			ackPayload[10] = proximityValue[10]>>8;
+			ackPayload[11] = proximityValue[12]&0xFF;
+			ackPayload[12] = proximityValue[12]>>8;
+			ackPayload[13] = proximityValue[14]&0xFF;
+			ackPayload[14] = proximityValue[14]>>8;
+			ackPayload[15] = currentSelector;
+			break;
+
+		case 6:
+			ackPayload[1] = proximityValue[8]&0xFF;
+			ackPayload[2] = proximityValue[8]>>8;
+			ackPayload[3] = proximityValue[16]&0xFF;
+			ackPayload[4] = proximityValue[16]>>8;
+			ackPayload[5] = proximityValue[18]&0xFF;
+			ackPayload[6] = proximityValue[18]>>8;
+			ackPayload[7] = proximityValue[20]&0xFF;
+			ackPayload[8] = proximityValue[20]>>8;
+			ackPayload[9] = proximityValue[22]&0xFF;
+			ackPayload[10] = proximityValue[22]>>8;
+			ackPayload[11] = accZ&0xFF;
+			ackPayload[12] = accZ>>8;	
+			ackPayload[13] = batteryLevel&0xFF;
+			ackPayload[14] = batteryLevel>>8;
+			ackPayload[15] = 0;
+			break;
+
+
+		case 7:
+			ackPayload[1] = ((signed long int)leftMotSteps)&0xFF;
+			ackPayload[2] = ((signed long int)leftMotSteps)>>8;
+			ackPayload[3] = ((signed long int)leftMotSteps)>>16;
+			ackPayload[4] = ((signed long int)leftMotSteps)>>24;
+			ackPayload[5] = ((signed long int)rightMotSteps)&0xFF;
+			ackPayload[6] = ((signed long int)rightMotSteps)>>8;
+			ackPayload[7] = ((signed long int)rightMotSteps)>>16;
+			ackPayload[8] = ((signed long int)rightMotSteps)>>24;
+			lastTheta = theta;
+			ackPayload[9] = ((signed int)(lastTheta*573.0))&0xFF;	// radians to degrees => 573 = 1800/PI
+			ackPayload[10] = ((signed int)(lastTheta*573.0))>>8;				
+			ackPayload[11] = ((unsigned int)xPos)&0xFF;
+			ackPayload[12] = ((unsigned int)xPos)>>8;
+			ackPayload[13] = ((unsigned int)yPos)&0xFF;
+			ackPayload[14] = ((unsigned int)yPos)>>8;
+			ackPayload[15] = 0;
+			break;
+
+	}
+
+}
+
+void setAckSchedule(unsigned char *ids, unsigned char len) {
+	unsigned char i = 0;
+
+	if(len == 0) {	// default schedule
+		for(i=0; i<RF_ACK_PACKETS_NUM; i++) {
+			rfAckSchedule[i] = RF_ACK_FIRST_PACKET+i;
+		}
+		rfAckScheduleLen = RF_ACK_PACKETS_NUM;
+		rfAckScheduleIndex = 0;
+		return;
+	}
+	if(len > RF_ACK_SCHEDULE_SIZE) {
+		return;
+	}
+	for(i=0; i<len; i++) {
+		if((ids[i] < RF_ACK_FIRST_PACKET) || (ids[i] >= (RF_ACK_FIRST_PACKET+RF_ACK_PACKETS_NUM))) {
+			return;	// unknown packet, keep the current schedule
+		}
+	}
+	for(i=0; i<len; i++) {
+		rfAckSchedule[i] = ids[i];
+	}
+	rfAckScheduleLen = len;
+	rfAckScheduleIndex = 0;
 }
 
 void rfEnableDebugMode() {
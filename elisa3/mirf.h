@@ -62,11 +62,20 @@ void mirf_set_TADDR(uint8_t * adr);
 uint8_t mirf_data_ready();
 void mirf_get_data(uint8_t * data);
 uint8_t rx_fifo_is_empty();
+uint8_t mirf_read_status();
 void flush_rx_fifo();
 
 void writeAckPayload(unsigned char *data, unsigned char size);
 void flushTxFifo();
 void handleRFCommands();
+void handleRFPacket(uint8_t pipe);
+void rfStartStatusPoll();
+void handleGroupCommand(unsigned char *data);
+void handleTimeBeacon(unsigned char *data);
+unsigned char rfGroupCommandDue();
+void rfTasks();
+void fillAckPayload();
+void setAckSchedule(unsigned char *ids, unsigned char len);
 uint8_t readPayloadWidthFromTopFifo();
 uint8_t readPayloadWidthFromPipe0();
 void rfEnableDebugMode();
@@ -217,11 +217,7 @@ void handleMotorsWithSpeedController() {
 
 		deltaDist = ((rightDist-rightDistPrev)+(leftDist-leftDistPrev))/2.0;
 
-		if(robotPosition == HORIZONTAL_POS) {
-			theta = (rightDist-leftDist)/WHEEL_DIST;
-		} else {
-			theta = thetaAcc;
-		}
+		updateHeadingFilter();
 
 		xPos = xPos + cos(theta)*deltaDist;				
 		yPos = yPos + sin(theta)*deltaDist;
@@ -230,6 +226,33 @@ void handleMotorsWithSpeedController() {
 
 }
 
+void updateHeadingFilter() {
+
+	signed long int thetaWheelQ12 = 0;
+	signed long int err = 0;
+
+	// prediction: heading variation measured by the wheels since the last odometry step
+	thetaWheelQ12 = (signed long int)((rightDist-leftDist)*(4096.0/WHEEL_DIST));
+	thetaFusedQ12 += thetaWheelQ12 - thetaWheelPrevQ12;
+	thetaWheelPrevQ12 = thetaWheelQ12;
+
+	// correction: move the heading towards the absolute orientation given by the accelerometer proportionally 
+	// to its confidence; when the robot is flat the confidence is 0 and the heading comes only from the wheels
+	if(headingConfidence > 0) {
+		err = thetaAccQ12 - (thetaFusedQ12 % (2*Q12_PI));	// shortest angular difference (-pi..pi)
+		while(err > Q12_PI) {
+			err -= 2*Q12_PI;
+		}
+		while(err < -Q12_PI) {
+			err += 2*Q12_PI;
+		}
+		thetaFusedQ12 += (err*HEADING_FUSION_GAIN*headingConfidence/100)>>8;
+	}
+
+	theta = (float)thetaFusedQ12/4096.0;
+
+}
+
 // vel expressed in 1/5 of mm/s
 void setLeftSpeed(signed char vel) {
 
@@ -70,6 +70,16 @@ void setLeftSpeed(signed char vel);
 void setRightSpeed(signed char vel);
 
 
+/**
+ * \brief Update the robot heading "theta" used by the odometry fusing the wheels and accelerometer information
+ * with a fixed-point complementary filter: the wheels give the heading variation and the accelerometer
+ * pulls the heading towards its absolute orientation, weighted by "headingConfidence". When the robot is flat
+ * the heading comes only from the wheels, when it is on a vertical wall it follows the accelerometer; the 
+ * transitions between the two are smooth.
+ * \return none
+ */
+void updateHeadingFilter();
+
 void handleCalibration();
 void updateOdomData();
 void initCalibration();
@@ -0,0 +1,116 @@
+
+#include "rfAseba.h"
+
+unsigned char rfAsebaIsFrame(unsigned char *data) {
+	if((data[0]&0xF0) == RF_ASEBA_FRAME) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+void rfAsebaReset() {
+	rfAsebaRxHead = 0;
+	rfAsebaRxTail = 0;
+	rfAsebaTxHead = 0;
+	rfAsebaTxTail = 0;
+	rfAsebaRxSeq = 0;
+	rfAsebaTxSeq = 0;
+	rfAsebaTxLen = 0;
+}
+
+void rfAsebaHandleFrame(unsigned char *data) {
+	unsigned char i = 0;
+	unsigned char len = data[3];
+
+	rfAsebaLastFrameTime = getTime100MicroSec();
+	rfAsebaConnected = 1;
+
+	if(data[0] & RF_ASEBA_FLAG_RESET) {
+		rfAsebaReset();
+		rfAsebaRxSeq = data[1];
+	} else if((data[0] & RF_ASEBA_FLAG_DATA) && (len <= RF_ASEBA_DOWN_DATA)) {
+		// accept only the next fragment and only if there is space for it, otherwise it isn't acknowledged
+		// and the computer will send it again
+		if((data[1] == (unsigned char)(rfAsebaRxSeq+1)) && (((RF_ASEBA_RX_BUFF_SIZE-1) - ((rfAsebaRxHead-rfAsebaRxTail)&(RF_ASEBA_RX_BUFF_SIZE-1))) >= len)) {
+			for(i=0; i<len; i++) {
+				rfAsebaRxBuff[rfAsebaRxHead] = data[RF_ASEBA_HEADER_SIZE+i];
+				rfAsebaRxHead = (rfAsebaRxHead+1)&(RF_ASEBA_RX_BUFF_SIZE-1);
+			}
+			rfAsebaRxSeq = data[1];
+		}
+	}
+
+	// the fragment sent is acknowledged, release it
+	if((rfAsebaTxLen > 0) && (data[2] == rfAsebaTxSeq)) {
+		rfAsebaTxTail = (rfAsebaTxTail+rfAsebaTxLen)&(RF_ASEBA_BUFF_SIZE-1);
+		rfAsebaTxLen = 0;
+	}
+
+	// prepare the next fragment
+	if(rfAsebaTxLen == 0) {
+		len = (rfAsebaTxHead-rfAsebaTxTail)&(RF_ASEBA_BUFF_SIZE-1);
+		if(len > 0) {
+			if(len > RF_ASEBA_UP_DATA) {
+				len = RF_ASEBA_UP_DATA;
+			}
+			rfAsebaTxSeq++;
+			rfAsebaTxLen = len;
+		}
+	}
+
+	if(rfAsebaTxLen > 0) {
+		ackPayload[0] = RF_ASEBA_FRAME | RF_ASEBA_FLAG_DATA;
+	} else {
+		ackPayload[0] = RF_ASEBA_FRAME;
+	}
+	ackPayload[1] = rfAsebaTxSeq;
+	ackPayload[2] = rfAsebaRxSeq;
+	ackPayload[3] = rfAsebaTxLen;
+	for(i=0; i<rfAsebaTxLen; i++) {
+		ackPayload[RF_ASEBA_HEADER_SIZE+i] = rfAsebaTxBuff[(rfAsebaTxTail+i)&(RF_ASEBA_BUFF_SIZE-1)];
+	}
+	writeAckPayload(ackPayload, RF_ASEBA_HEADER_SIZE+rfAsebaTxLen);
+}
+
+unsigned char rfAsebaIsConnected() {
+	if(rfAsebaConnected && ((getTime100MicroSec()-rfAsebaLastFrameTime) > RF_ASEBA_LINK_TIMEOUT)) {
+		rfAsebaConnected = 0;
+	}
+	return rfAsebaConnected;
+}
+
+void rfAsebaSendByte(unsigned char value) {
+	while(((RF_ASEBA_BUFF_SIZE-1) - ((rfAsebaTxHead-rfAsebaTxTail)&(RF_ASEBA_BUFF_SIZE-1))) == 0) {
+		if(rfAsebaIsConnected() == 0) {
+			return;
+		}
+		rfTasks();
+	}
+	rfAsebaTxBuff[rfAsebaTxHead] = value;
+	rfAsebaTxHead = (rfAsebaTxHead+1)&(RF_ASEBA_BUFF_SIZE-1);
+}
+
+unsigned int rfAsebaGetMessage(unsigned char *data, unsigned int maxLength, unsigned int *source) {
+	unsigned int count = (rfAsebaRxHead-rfAsebaRxTail)&(RF_ASEBA_RX_BUFF_SIZE-1);
+	unsigned int len = 0;
+	unsigned int i = 0;
+
+	if(count < 4) {	// length and source not yet received
+		return 0;
+	}
+	len = (rfAsebaRxBuff[rfAsebaRxTail] | (rfAsebaRxBuff[(rfAsebaRxTail+1)&(RF_ASEBA_RX_BUFF_SIZE-1)]<<8)) + 2;	// msg type + data
+	if((len > maxLength) || ((len+4) > (RF_ASEBA_RX_BUFF_SIZE-1))) {	// wrong data received or message too big, discard the stream
+		rfAsebaRxTail = rfAsebaRxHead;
+		return 0;
+	}
+	if(count < (len+4)) {	// the message isn't complete yet
+		return 0;
+	}
+	*source = rfAsebaRxBuff[(rfAsebaRxTail+2)&(RF_ASEBA_RX_BUFF_SIZE-1)] | (rfAsebaRxBuff[(rfAsebaRxTail+3)&(RF_ASEBA_RX_BUFF_SIZE-1)]<<8);
+	for(i=0; i<len; i++) {
+		data[i] = rfAsebaRxBuff[(rfAsebaRxTail+4+i)&(RF_ASEBA_RX_BUFF_SIZE-1)];
+	}
+	rfAsebaRxTail = (rfAsebaRxTail+4+len)&(RF_ASEBA_RX_BUFF_SIZE-1);
+	return len;
+}
@@ -0,0 +1,86 @@
+#ifndef RF_ASEBA_H
+#define RF_ASEBA_H
+
+
+/**
+ * \file rfAseba
+ * \brief Aseba transport through the radio
+ * \author Stefano Morgani <stefano@gctronic.com>
+ * \version 1.0
+ * \date 19.10.26
+ * \copyright GNU GPL v3
+
+ The Aseba messages are exchanged with the computer also through the radio, using the same stream of the serial
+ connection (length, source, type, payload) split in fragments. The robot is always the receiver: the computer sends
+ frames of PAYLOAD_SIZE bytes and the robot answers with the ack payload (up to ACK_PAYLOAD_SIZE bytes), loaded for
+ the next frame received.
+ Each frame (in both directions) has the format: RF_ASEBA_FRAME | flags, sequence number, ack (sequence number of the
+ last fragment received from the other side), length, fragment data. A fragment is sent again until it is acknowledged,
+ the fragments with an unexpected sequence number (duplicates) are discarded. The computer starts the link with a
+ frame with the RF_ASEBA_FLAG_RESET flag, whose sequence number is the one preceding the first fragment.
+ The link is considered active as long as frames are received from the computer (RF_ASEBA_LINK_TIMEOUT).
+ The received stream is reassembled in a buffer of RF_ASEBA_RX_BUFF_SIZE bytes, big enough to hold the longest Aseba
+ message (ASEBA_MAX_INNER_PACKET_SIZE plus length and source).
+ The frames are recognized by "handleRFCommands", called by "rfTasks" that must be called in the main loop.
+ The other packets of the computer (motors, leds, ... commands) are decoded only if "rfLegacyCommandsEnabled" is set
+ (Aseba native radio.commands.enable), otherwise they only get the sensors packets back in the ack payload.
+*/
+
+
+#include "variables.h"
+#include "mirf.h"
+#include "utility.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Check whether the data received through the radio is an Aseba frame or a command.
+ * \param data data received
+ * \return 1 if it is an Aseba frame, 0 otherwise
+ */
+unsigned char rfAsebaIsFrame(unsigned char *data);
+
+/**
+ * \brief Handle an Aseba frame received from the computer: save the new fragment, release the fragment acknowledged
+ * by the computer and load the next fragment to send in the ack payload.
+ * \param data frame received (PAYLOAD_SIZE bytes)
+ * \return none
+ */
+void rfAsebaHandleFrame(unsigned char *data);
+
+/**
+ * \brief Clear the buffers and sequence numbers of the link.
+ * \return none
+ */
+void rfAsebaReset();
+
+/**
+ * \brief Check whether a computer is connected through the radio (a frame was received within RF_ASEBA_LINK_TIMEOUT).
+ * \return 1 if connected, 0 otherwise
+ */
+unsigned char rfAsebaIsConnected();
+
+/**
+ * \brief Append a byte to the stream sent to the computer; if the buffer is full the radio is handled until there 
+ * is space again (blocking), the byte is discarded if the link is lost in the meanwhile.
+ * \param value byte to send
+ * \return none
+ */
+void rfAsebaSendByte(unsigned char value);
+
+/**
+ * \brief Get the next complete Aseba message received through the radio.
+ * \param data buffer in which the message type and payload are copied
+ * \param maxLength size of the buffer
+ * \param source the source node of the message is returned here
+ * \return the message length (type + payload), 0 if no complete message is available
+ */
+unsigned int rfAsebaGetMessage(unsigned char *data, unsigned int maxLength, unsigned int *source);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -2,53 +2,62 @@
 #include "sensors.h"
 
 
-void calibrateSensors() {
-
-	unsigned int i=0;
-
-	pwm_red = 0;
-	pwm_green = 0;
-	pwm_blue = 0;
+void setCalibrationLeds(unsigned char red, unsigned char green, unsigned char blue) {
+	pwm_red = red;
+	pwm_green = green;
+	pwm_blue = blue;
 	updateRedLed(pwm_red);
 	updateGreenLed(pwm_green);
 	updateBlueLed(pwm_blue);
+}
+
+void calibrateSensorsStart() {
+
+	setCalibrationLeds(0, 0, 0);
 
 	calibrationCycle = 0;
 	startCalibration = 1;
+	calibrationTick = getTime100MicroSec();
+	calibrationState = SENS_CALIB_STATE_ACC_SETTLE;
 
+}
 
-	// calibrate accelerometer
-
-	lastTick = getTime100MicroSec();
-	while((getTime100MicroSec() - lastTick) < PAUSE_100_MSEC) {
-		readAccelXYZ();	// get a fresh value from the accelerometer
-	}
-	
-	accXMax = -1023;
-	accXMin = 1023;
-	accYMax = -1023;
-	accYMin = 1023;
-	accOffsetXSum = 0;
-	accOffsetYSum = 0;
+unsigned char calibrateSensorsTask() {
 
-	if(abs(accZ) >= VERTICAL_THRESHOLD) {
+	unsigned int i=0;
 
-		pwm_red = 0;
-		pwm_green = 255;
-		pwm_blue = 255;
-		updateRedLed(pwm_red);
-		updateGreenLed(pwm_green);
-		updateBlueLed(pwm_blue);
+	switch(calibrationState) {
 
-		setLeftSpeed(0);
-		setRightSpeed(0);
+		case SENS_CALIB_STATE_ACC_SETTLE:			// get fresh values from the accelerometer
+			readAccelXYZ();
+			if((getTime100MicroSec() - calibrationTick) < PAUSE_100_MSEC) {
+				break;
+			}
 
-		while(1) {
+			accXMax = -1023;
+			accXMin = 1023;
+			accYMax = -1023;
+			accYMin = 1023;
+			accOffsetXSum = 0;
+			accOffsetYSum = 0;
+
+			if(abs(accZ) >= VERTICAL_THRESHOLD) {
+				setCalibrationLeds(0, 255, 255);
+				setLeftSpeed(0);
+				setRightSpeed(0);
+				calibrationState = SENS_CALIB_STATE_ACC_FLAT;
+			} else {
+				setCalibrationLeds(255, 0, 255);
+				setLeftSpeed(-10);
+				setRightSpeed(10);
+				calibrationTick = getTime100MicroSec();
+				calibrationState = SENS_CALIB_STATE_ACC_SPIN;
+			}
+			break;
 
+		case SENS_CALIB_STATE_ACC_FLAT:				// robot flat: average some samples
 			readAccelXYZ();
-
 			handleMotorsWithNoController();
-
 			if(calibrationCycle < CALIBRATION_CYCLES) {
 				accOffsetXSum += accX;
 				accOffsetYSum += accY;
@@ -56,32 +65,15 @@ void calibrateSensors() {
 			} else {
 				accOffsetX = accOffsetXSum>>4;
 				accOffsetY = accOffsetYSum>>4;
-				break;
+				calibrationCycle = 0;
+				calibrationState = SENS_CALIB_STATE_PROX;
 			}
+			break;
 
-		}
-
-	} else {
-
-		pwm_red = 255;
-		pwm_green = 0;
-		pwm_blue = 255;
-		updateRedLed(pwm_red);
-		updateGreenLed(pwm_green);
-		updateBlueLed(pwm_blue);
-
-		setLeftSpeed(-10);
-		setRightSpeed(10);
-
-		lastTick = getTime100MicroSec();
-
-		while(1) {
-
+		case SENS_CALIB_STATE_ACC_SPIN:				// robot vertical: turn on itself and take the middle of the measured range
 			readAccelXYZ();
-
 			handleMotorsWithSpeedController();
-
-			if((getTime100MicroSec()-lastTick) < PAUSE_4_SEC) {
+			if((getTime100MicroSec()-calibrationTick) < PAUSE_4_SEC) {
 				if(accXMax < accX) {
 					accXMax = accX;
 				}
@@ -94,69 +86,44 @@ void calibrateSensors() {
 				if(accYMin > accY) {
 					accYMin = accY;
 				}
-				calibrationCycle++;
 			} else {
 				accOffsetX = (accXMax + accXMin)>>1;
 				accOffsetY = (accYMax + accYMin)>>1;
-				break;
+				setLeftSpeed(0);
+				setRightSpeed(0);
+				calibrationCycle = 0;
+				calibrationState = SENS_CALIB_STATE_PROX;
 			}
+			break;
 
-		}
-
-		setLeftSpeed(0);
-		setRightSpeed(0);
-
-	}	
-
-	startCalibration = 1;
-	calibrationCycle = 0;
-
-	// calibrate prox and ground sensors
-	while(startCalibration) {
-
-		if(calibrationCycle<=CALIBRATION_CYCLES) {
-
-			if(proxUpdated) {
-
-				pwm_red = 255;
-				pwm_green = 255;
-				pwm_blue = 0;
-				updateRedLed(pwm_red);
-				updateGreenLed(pwm_green);
-				updateBlueLed(pwm_blue);
-
-				proxUpdated = 0;
-
-				if(calibrationCycle==0) {		// reset all variables
-
-					for(i=0; i<12; i++) {
-						proximitySum[i] = 0;
-						proximityOffset[i] = 0;
-					}				
-					
-					calibrationCycle++;
+		case SENS_CALIB_STATE_PROX:					// calibrate prox and ground sensors
+			if(!proxUpdated) {
+				break;
+			}
+			proxUpdated = 0;
 
-					continue;					// the first time "proxUpdated" is set, all the proximity values saved in the array 
-												// "proximityResult" hasn't the offset reset to 0. so we start the actual calibration
-												// the next time
-				}
+			setCalibrationLeds(255, 255, 0);
 
-				for (i=0;i<12;i++) {
-					proximitySum[i] += proximityResult[i];
+			if(calibrationCycle==0) {		// reset all variables
+				for(i=0; i<12; i++) {
+					proximitySum[i] = 0;
+					proximityOffset[i] = 0;
 				}
-
 				calibrationCycle++;
+				break;						// the first time "proxUpdated" is set, all the proximity values saved in the array 
+											// "proximityResult" hasn't the offset reset to 0. so we start the actual calibration
+											// the next time
+			}
 
+			for (i=0;i<12;i++) {
+				proximitySum[i] += proximityResult[i];
 			}
 
-		} else {
+			calibrationCycle++;
 
-			pwm_red = 0;
-			pwm_green = 0;
-			pwm_blue = 255;
-			updateRedLed(pwm_red);
-			updateGreenLed(pwm_green);
-			updateBlueLed(pwm_blue);
+			if(calibrationCycle <= CALIBRATION_CYCLES) {
+				break;
+			}
 
 			for(i=0;i<12;i++) {
 				proximityOffset[i] = proximitySum[i]>>4;
@@ -166,23 +133,31 @@ void calibrateSensors() {
 				proximityOffset[i] -= 512;	// move the "0" to 512 (values around 512)
 			}
 
-			//proxUpdated = 0;
-			//if(proxUpdated) {	
-				startCalibration = 0;					
-			//} else { // wait for the sensors to be updated => it will block here...why??
-			//	continue;
-			//}
+			startCalibration = 0;
+			writeSensorsCalibrationToFlash();
+			resetProximityBaseline();
+			setCalibrationLeds(255, 255, 255);
+			calibrationState = SENS_CALIB_STATE_IDLE;
+
+			if(calibrationNext == SENS_CALIB_NEXT_RESET_ODOM) {
+				resetOdometry();
+			} else if(calibrationNext == SENS_CALIB_NEXT_ODOM_CALIB) {
+				proximityResult[8] = 1023;	// because the first time this value could be low after calibration
+				proximityResult[11] = 1023;	// and in that case a false black line will be detected
+				calibState = CALIBRATION_STATE_FIND_THRS_0;
+				calibVelIndex = 1;
+				calibrateOdomFlag = 1;
+			}
+			calibrationNext = SENS_CALIB_NEXT_NONE;
+			break;
 
-		}
+		default:
+			calibrationState = SENS_CALIB_STATE_IDLE;
+			break;
 
 	}
 
-	pwm_red = 255;
-	pwm_green = 255;
-	pwm_blue = 255;
-	updateRedLed(pwm_red);
-	updateGreenLed(pwm_green);
-	updateBlueLed(pwm_blue);
+	return (calibrationState != SENS_CALIB_STATE_IDLE);
 
 }
 
@@ -190,7 +165,8 @@ void initAccelerometer() {
 
 	unsigned char ret;
 
-	i2c_init();		// init I2C bus
+	i2c_init();		// init I2C bus (standard mode)
+	accelI2cClock = I2C_CLOCK_STANDARD;
 
 	ret = initMMA7455L();
 
@@ -204,6 +180,67 @@ void initAccelerometer() {
 		}
 	}
 
+	// the device is detected in standard mode, then try to switch to fast mode: the fast mode is kept only
+	// if the device can be identified reliably at the higher clock, otherwise go back to standard mode
+	if(useAccel != USE_NO_ACCEL) {
+		i2c_set_clock(I2C_CLOCK_FAST);
+		if(checkAccelerometerId() == 0) {
+			accelI2cClock = I2C_CLOCK_FAST;
+		} else {
+			i2c_set_clock(I2C_CLOCK_STANDARD);
+		}
+	}
+
+}
+
+unsigned char readAccelRegister(unsigned char reg, unsigned char *value) {
+
+	if(i2c_start(accelAddress+I2C_WRITE)) {		// set device address and write mode
+		i2c_stop();
+		return 1;
+	}
+	if(i2c_write(reg)) {						// sends address to read from
+		i2c_stop();
+		return 1;
+	}
+	if(i2c_rep_start(accelAddress+I2C_READ)) {	// set device address and read mode
+		i2c_stop();
+		return 1;
+	}
+	*value = i2c_readNak();						// read one byte sending NACK
+	i2c_stop();									// set stop conditon = release bus
+
+	return 0;
+
+}
+
+unsigned char checkAccelerometerId() {
+
+	unsigned char i = 0;
+	unsigned char value = 0;
+	unsigned char reg = 0, expected = 0;
+
+	if(useAccel == USE_MMAX7455L) {
+		reg = MMA7455L_WHOAMI_REG;
+		expected = MMA7455L_WHOAMI_VALUE;
+	} else if(useAccel == USE_ADXL345) {
+		reg = ADXL345_DEVID_REG;
+		expected = ADXL345_DEVID_VALUE;
+	} else {
+		return 1;
+	}
+
+	for(i=0; i<ACCEL_CLOCK_PROBE_READS; i++) {
+		if(readAccelRegister(reg, &value)) {
+			return 1;
+		}
+		if(value != expected) {
+			return 1;
+		}
+	}
+
+	return 0;
+
 }
 
 unsigned char initMMA7455L() {
@@ -513,6 +550,8 @@ void readAccelXYZ_2() {
 
 void computeAngle() {
 
+	unsigned int accXYMagnitude = 0;
+
 	// check the robot motion plane (horizontal or vertical) based on the Z axes;
 	if(abs(accZ) >= VERTICAL_THRESHOLD) {
 		currPosition = HORIZONTAL_POS;
@@ -529,9 +568,21 @@ void computeAngle() {
 		timesInSamePos = 0;
 	}
 
-	// compute the angle using the X and Y axis
-	thetaAcc = atan2((float)accX, (float)accY);
-	currentAngle = (signed int)(thetaAcc*RAD_2_DEG);
+	// compute the angle using the X and Y axis (fixed-point, the floating point value is used by the odometry)
+	thetaAccQ12 = atan2Q12(accX, accY);
+	thetaAcc = (float)thetaAccQ12/4096.0;
+	currentAngle = radQ12ToDeg(thetaAccQ12);
+
+	// confidence of the accelerometer heading: it depends on how much of the gravity is projected in the X-Y plane,
+	// that is about 0 when the robot is flat and maximum when it is on a vertical wall
+	accXYMagnitude = abs(accX) + abs(accY);
+	if(accXYMagnitude <= HEADING_ACC_MAG_LOW) {
+		headingConfidence = 0;
+	} else if(accXYMagnitude >= HEADING_ACC_MAG_HIGH) {
+		headingConfidence = 100;
+	} else {
+		headingConfidence = (unsigned char)((accXYMagnitude-HEADING_ACC_MAG_LOW)*100/(HEADING_ACC_MAG_HIGH-HEADING_ACC_MAG_LOW));
+	}
 
 	if(currentAngle < 0) {
 		currentAngle = currentAngle + (signed int)360;	// angles from 0 to 360
@@ -552,3 +603,33 @@ void readTemperature() {
 	}
 }
 
+void resetProximityBaseline() {
+	unsigned char i=0;
+	for(i=0; i<8; i++) {
+		proximityBaseline[i] = (signed long int)proximityOffset[i]<<8;
+	}
+}
+
+void updateProximityBaseline() {
+
+	unsigned char i=0;
+	signed long int raw=0;
+	signed int offset=0;
+
+	if(!proxBaselineEnabled || calibrationState!=SENS_CALIB_STATE_IDLE) {
+		return;
+	}
+
+	for(i=0; i<8; i++) {
+		raw = (signed int)proximityValue[i*2] - (signed int)proximityValue[i*2+1];	// ambient - (ambient+reflected)
+		if(raw < (proximityBaseline[i]>>8) + PROX_BASELINE_WINDOW) {	// no obstacle => follow the ambient drift
+			proximityBaseline[i] += ((raw<<8) - proximityBaseline[i])>>PROX_BASELINE_SHIFT;
+			offset = (signed int)(proximityBaseline[i]>>8);
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {		// "proximityOffset" is used within the adc isr
+				proximityOffset[i] = offset;
+			}
+		}
+	}
+
+}
+
@@ -27,6 +27,8 @@
 #include "twimaster.h"
 #include "motors.h"
 #include "utility.h"
+#include "eepromIO.h"
+#include <util/atomic.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,19 +36,58 @@ extern "C" {
 #endif
 
 /**
- * \brief Calibrate all the sensors (proximity, ground and accelerometer). Pay attention for the robot
- * to be positionated in a flat surface and that no objects obstruct the sensors.
+ * \brief Start the sensors calibration (proximity, ground and accelerometer) without blocking; the calibration
+ * is then carried out by calling "calibrateSensorsTask" periodically. The resulting offsets are saved in eeprom.
+ * Pay attention for the robot to be positionated in a flat surface and that no objects obstruct the sensors.
  * Peripherals need to be already initialized before calling this function.
  * \return none
  */
-void calibrateSensors();
+void calibrateSensorsStart();
 
 /**
- * \brief Test which device is mounted on the robot and configure it.
+ * \brief Execute one step of the sensors calibration state machine (accelerometer settling, accelerometer
+ * calibration flat or turning on itself when vertical, proximity and ground calibration). It has to be called
+ * periodically (e.g. from the main loop) after "calibrateSensorsStart"; the motors are driven by this function
+ * during the accelerometer calibration.
+ * \retval 1 calibration in progress
+ * \retval 0 calibration finished (or not started)
+ */
+unsigned char calibrateSensorsTask();
+
+/**
+ * \brief Set the RGB leds color used to show the calibration progress.
+ * \param red red intensity (0=max power, 255=off)
+ * \param green green intensity (0=max power, 255=off)
+ * \param blue blue intensity (0=max power, 255=off)
+ * \return none
+ */
+void setCalibrationLeds(unsigned char red, unsigned char green, unsigned char blue);
+
+/**
+ * \brief Test which device is mounted on the robot and configure it. The device is detected in I2C standard
+ * mode (100 KHz), then the fast mode (400 KHz) is tried and kept only if the device identification register
+ * can be read reliably; the clock chosen is saved in the global variable "accelI2cClock".
  * \return none
  */
 void initAccelerometer();
 
+/**
+ * \brief Read a single register from the accelerometer currently in use.
+ * \param reg register address
+ * \param value reference where the register content is saved
+ * \retval 0 read ok
+ * \retval 1 communication error
+ */
+unsigned char readAccelRegister(unsigned char reg, unsigned char *value);
+
+/**
+ * \brief Read the identification register of the accelerometer several times (ACCEL_CLOCK_PROBE_READS)
+ * and check its content; used to verify the communication at the current I2C clock.
+ * \retval 0 device identified correctly at every read
+ * \retval 1 communication error or unexpected content
+ */
+unsigned char checkAccelerometerId();
+
 /**
  * \brief Configure the ADXL345 accelerometer (2g sensitivity, 10 bits resolution).
  * \retval 0 configuration ok
@@ -86,12 +127,28 @@ void readAccelXYZ_2();
  * the angle to be computed correctly, the robot has to be calibrated leaving it flat on the ground.
  * Moreover this function update the robot motion plane (horizontal or vertical) based on the Z axis; this
  * information is then used to switch between horizontal and vertical speed controller.
+ * The confidence of the accelerometer heading (used by the odometry heading filter) is updated too.
  * \return none
  */
 void computeAngle();
 
 void readTemperature();
 
+/**
+ * \brief Initialize the tracked proximity baseline with the current offsets; to be called after the offsets are 
+ * computed or loaded from eeprom.
+ * \return none
+ */
+void resetProximityBaseline();
+
+/**
+ * \brief Update the proximity offsets (sensors 0..7) following slowly the ambient light drift: when no obstacle
+ * is detected by a sensor its raw value is averaged (exponential moving average) in the baseline that is then 
+ * used as offset. To be called every time the proximity values are updated ("proxUpdated").
+ * \return none
+ */
+void updateProximityBaseline();
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
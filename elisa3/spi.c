@@ -27,6 +27,7 @@ void SPI_WAIT() {
 		timeout++;
 		if(timeout>=10000) {
 			spiCommError = 1;
+			return;
 		}
 	
 		if(SPSR & _BV(SPIF)) {
@@ -0,0 +1,119 @@
+
+#include <math.h>
+#include <string.h>
+#include "irChannelSim.h"
+
+#define SIM_TICK_SEC 0.000104
+#define SIM_CONTACT_SIGNAL 900.0				// signal with the robots touching
+#define SIM_HALF_DISTANCE 1.8					// cm, the signal is divided by 1+(d/SIM_HALF_DISTANCE)^2
+#define SIM_FLICKER_HZ 100.0
+
+void simInit(SimChannel *ch, unsigned long int seed) {
+	ch->numTx = 0;
+	memset(ch->tx, 0, sizeof(ch->tx));
+	ch->ambient = 950;
+	ch->flicker = 10;
+	ch->noise = 4;
+	ch->seed = seed;
+}
+
+double simRandom(SimChannel *ch) {
+	ch->seed = ch->seed*1103515245 + 12345;	// linear congruential generator, same sequence on any computer
+	return (double)((ch->seed>>16)&0x7FFF)/32767.0;
+}
+
+double simGaussian(SimChannel *ch) {
+	double u1 = simRandom(ch), u2 = simRandom(ch);
+	if(u1 < 1e-9) {
+		u1 = 1e-9;
+	}
+	return sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+}
+
+double simGain(double distance, double angle) {
+	double c = cos(angle*M_PI/180.0);
+	if(c <= 0) {
+		return 0;
+	}
+	return SIM_CONTACT_SIGNAL*c/(1.0 + (distance/SIM_HALF_DISTANCE)*(distance/SIM_HALF_DISTANCE));
+}
+
+unsigned char simTxOn(SimTransmitter *tx, int tick) {
+	int window = tick/SIM_WINDOW_TICKS;
+	int pos = tick%SIM_WINDOW_TICKS;
+	unsigned char bit = 0;
+
+	if(tx->lineCode == IRCOMM_CODE_MANCHESTER) {
+		// two bits per window, each made of two halves: "1" = on then off, "0" = off then on
+		bit = tx->bits[window*2 + pos/(2*IRCOMM_MANCHESTER_HALF_DURATION)];
+		if(((pos/IRCOMM_MANCHESTER_HALF_DURATION)%2) == 0) {
+			return bit;
+		} else {
+			return !bit;
+		}
+	}
+	// one bit per window, the IR is switched every bit duration starting with the IR on
+	bit = tx->bits[window];
+	if(bit) {
+		return ((pos/IRCOMM_BIT1_DURATOIN)%2) == 0;
+	} else {
+		return ((pos/IRCOMM_BIT0_DURATION)%2) == 0;
+	}
+}
+
+unsigned char simTxPulseOn(SimTransmitter *tx, int tick, int *proxSamples) {
+	int t = 0, i = 0, next = tx->pulsePhase, pulseEnd = -1, count = 0;
+	unsigned char lastProx = 0, proxIndex = 0, off = 0;
+
+	// sequence of the sensors samples from the start of the windows; the proximity needs the transmission
+	// pulse off from the tick before the sample to IRCOMM_INTERLEAVE_TX_MARGIN ticks after
+	for(t=0; t<=tick; t++) {
+		if(t == next) {
+			off = 1;
+			for(i=t-1; i<=t+IRCOMM_INTERLEAVE_TX_MARGIN+1 && i<2*SIM_WINDOW_TICKS; i++) {
+				if(i>=0 && simTxOn(tx, i)) {
+					off = 0;
+				}
+			}
+			if(off && lastProx==0) {
+				if(proxIndex & 0x01) {			// active phase
+					pulseEnd = t + SIM_PULSE_TICKS;
+				}
+				proxIndex++;
+				count++;
+				lastProx = 1;
+			} else {
+				lastProx = 0;
+			}
+			next = t + SIM_INTERLEAVE_TICKS;
+		}
+	}
+	if(proxSamples != NULL) {
+		*proxSamples = count;
+	}
+	return (tx->pulseGain > 0) && (tick < pulseEnd);
+}
+
+void simReceiveWindow(SimChannel *ch, signed int *samples) {
+	int i = 0, t = 0, k = 0;
+	double value = 0, phase = simRandom(ch)*2.0*M_PI;
+
+	for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+		t = i*SIM_SAMPLE_TICKS;
+		value = ch->ambient + ch->flicker*sin(2.0*M_PI*SIM_FLICKER_HZ*t*SIM_TICK_SEC + phase) + ch->noise*simGaussian(ch);
+		for(k=0; k<ch->numTx; k++) {
+			if(simTxOn(&ch->tx[k], t - ch->tx[k].offset)) {
+				value -= simGain(ch->tx[k].distance, ch->tx[k].angle);
+			} else if(simTxPulseOn(&ch->tx[k], t - ch->tx[k].offset, NULL)) {
+				value -= ch->tx[k].pulseGain*simGain(ch->tx[k].distance, ch->tx[k].angle);
+			}
+		}
+		if(value < 0) {
+			value = 0;
+		}
+		if(value > 1023) {
+			value = 1023;
+		}
+		samples[i] = (signed int)lround(value);
+	}
+}
@@ -0,0 +1,108 @@
+#ifndef IR_CHANNEL_SIM_H
+#define IR_CHANNEL_SIM_H
+
+
+/**
+ * \file irChannelSim.h
+ * \brief Simulation of the IR local communication channel between robots (host tests)
+ * \author Stefano Morgani <stefano@gctronic.com>
+ * \version 1.0
+ * \date 19.10.26
+ * \copyright GNU GPL v3
+
+ The simulator produces the sampling window of one proximity sensor of the receiving robot while up to
+ SIM_MAX_ROBOTS robots transmit. Each transmitter is placed at a distance and angle from the sensor and
+ starts its sampling window at an offset from the one of the receiver (synchronization error of the
+ transmitter being received, random phase of the other robots). The sensor value is the ambient level,
+ lowered by the IR light received (as on the robot), plus the ambient light flicker (100 Hz) and gaussian
+ noise, saturated in the adc range.
+ Timings are the ones of the firmware: adc interrupt of 104 us (tick), one sample of the sensor every
+ SIM_SAMPLE_TICKS ticks, IRCOMM_SAMPLING_WINDOW samples per window.
+ A transmitter can also emit the IR pulses of the proximity samples it takes while transmitting (adc.c,
+ irCommInterleavePulse): they follow the same sequence of the firmware (a sensor sample every
+ SIM_INTERLEAVE_TICKS ticks alternating proximity and ground, only while the transmission pulse stays off,
+ pulse only in the active phase) and are received with a fraction of the transmission signal.
+ Scope: the simulator covers the physical channel and the bit decoding only. The firmware state machines
+ (irCommTasks, the adc reception/transmission sequences, byte and packet framing, carrier sense and backoff)
+ aren't run, so the throughput (bytes/s) and the latency of the communication aren't measured; the results
+ are bit error rates of single windows.
+*/
+
+
+#include "constants.h"
+
+#define SIM_MAX_ROBOTS 8
+#define SIM_SAMPLE_TICKS 12						// ticks between two samples of the same sensor
+#define SIM_WINDOW_TICKS (SIM_SAMPLE_TICKS*IRCOMM_SAMPLING_WINDOW)
+#define SIM_TX_BITS 4							// bits of the two windows of a transmitter overlapping the receiver window
+#define SIM_INTERLEAVE_TICKS (2*IRCOMM_INTERLEAVE_TX_PERIOD+2)	// ticks between two sensors samples during transmission
+#define SIM_PULSE_TICKS 2						// duration of the IR pulse of a proximity sample
+
+typedef struct {
+	double distance;							// cm from the sensor
+	double angle;								// degrees from the sensor axis
+	unsigned char lineCode;						// IRCOMM_CODE_FREQUENCY or IRCOMM_CODE_MANCHESTER
+	int offset;									// start of its window relative to the receiver window (-SIM_WINDOW_TICKS+1..0 ticks)
+	unsigned char bits[SIM_TX_BITS];			// bits sent in the two windows (frequency: 1 bit per window, Manchester: 2)
+	double pulseGain;							// proximity pulses received as a fraction of the transmission signal (0 = no pulses)
+	int pulsePhase;								// start of the sensors samples sequence (0..SIM_INTERLEAVE_TICKS-1 ticks)
+} SimTransmitter;
+
+typedef struct {
+	int numTx;
+	SimTransmitter tx[SIM_MAX_ROBOTS];
+	double ambient;								// sensor value without IR light received
+	double flicker;								// amplitude of the ambient light flicker at 100 Hz
+	double noise;								// standard deviation of the sensor noise
+	unsigned long int seed;
+} SimChannel;
+
+/**
+ * \brief Initialize the channel without transmitters and with typical ambient light and noise.
+ * \param ch channel
+ * \param seed seed of the random numbers (the results are reproducible)
+ * \return none
+ */
+void simInit(SimChannel *ch, unsigned long int seed);
+
+/**
+ * \brief Uniform random number.
+ * \param ch channel (random generator state)
+ * \return number in the range 0..1
+ */
+double simRandom(SimChannel *ch);
+
+/**
+ * \brief Peak signal of a transmitter on the sensor (how much the sensor value is lowered).
+ * \param distance cm
+ * \param angle degrees from the sensor axis
+ * \return signal amplitude (adc units)
+ */
+double simGain(double distance, double angle);
+
+/**
+ * \brief Tell whether the IR of a transmitter is on at some time of its sampling windows.
+ * \param tx transmitter
+ * \param tick time from the start of its first window (0..2*SIM_WINDOW_TICKS-1)
+ * \return 1 if the IR is on, 0 otherwise
+ */
+unsigned char simTxOn(SimTransmitter *tx, int tick);
+
+/**
+ * \brief Tell whether the IR pulse of a proximity sample of a transmitter is on at some time of its sampling windows.
+ * \param tx transmitter
+ * \param tick time from the start of its first window (0..2*SIM_WINDOW_TICKS-1)
+ * \param proxSamples if not NULL, the number of proximity samples taken up to this time is written here
+ * \return 1 if the pulse is on, 0 otherwise
+ */
+unsigned char simTxPulseOn(SimTransmitter *tx, int tick, int *proxSamples);
+
+/**
+ * \brief Produce the samples of the sensor for one receiver window.
+ * \param ch channel
+ * \param samples IRCOMM_SAMPLING_WINDOW samples are written here
+ * \return none
+ */
+void simReceiveWindow(SimChannel *ch, signed int *samples);
+
+#endif
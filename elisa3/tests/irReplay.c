@@ -0,0 +1,309 @@
+
+// Replay of the IR reception captures (format in irCommunication.h, enable DEBUG_READ_BIT and
+// DEBUG_BYTE_RECEPTION in constants.h and save the uart0 stream to a file) through the decoding of
+// irCommCodec.c. The bits decoded from the data bit windows are assembled in bytes and compared to the
+// byte records written by the robot; the results are reported for each line code.
+// The windows are decoded with the same irCommCodec functions of the firmware but not through the reception
+// state machine of irCommTasks (start bits, synchronization, sensor selection): the bit windows of the capture
+// are those the robot already synchronized and selected. No execution time is reported: the time on this
+// computer says nothing about the cycles on the AVR.
+// usage: irReplay capture.bin        replay a capture
+//        irReplay -g capture.bin     write a synthetic capture (simulated channel, 2 cm) to test the replay
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "irCommCodec.h"
+#include "irChannelSim.h"
+
+#define MAX_PAYLOAD (8+8*IRCOMM_SAMPLING_WINDOW*2)
+#define SYNTH_BYTES 200
+
+typedef struct {
+	unsigned long int bytes;			// byte records compared
+	unsigned long int byteErrors;		// replayed byte different from the one received by the robot
+	unsigned long int bitErrors;
+	unsigned long int undecided;		// windows in which a bit couldn't be decided
+	unsigned long int crcErrors;		// replayed bytes failing the crc
+	unsigned long int robotCrcErrors;	// bytes the robot itself received with a crc error (not compared)
+	unsigned long int windows;
+} ReplayStats;
+
+// same as crc8Update in utility.c
+unsigned char crc8(unsigned char crc, unsigned char data) {
+	unsigned char i = 0;
+	crc ^= data;
+	for(i=0; i<8; i++) {
+		if(crc & 0x80) {
+			crc = (crc<<1) ^ 0x07;
+		} else {
+			crc = crc<<1;
+		}
+	}
+	return crc;
+}
+
+// decode the data bits of a window as the firmware does, returns the number of bits decided
+unsigned char decodeWindow(unsigned char lineCode, signed int *samples, unsigned char *bits) {
+	signed int signal[IRCOMM_SAMPLING_WINDOW];
+	signed int min = 1024, max = 0;
+	signed long int power0 = 0, power1 = 0;
+	unsigned char conf = 0;
+	int i = 0;
+
+	for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+		signal[i] = samples[i];
+		if(min > signal[i]) {
+			min = signal[i];
+		}
+		if(max < signal[i]) {
+			max = signal[i];
+		}
+	}
+	if((max-min) < IRCOMM_DETECTION_AMPLITUDE_THR) {
+		return 0;
+	}
+	if(lineCode == IRCOMM_CODE_MANCHESTER) {
+		for(i=0; i<2; i++) {
+			bits[i] = irCommDecodeManchesterBit(&signal[i*(IRCOMM_SAMPLING_WINDOW/2)], IRCOMM_SAMPLING_WINDOW/4, max-min, IRCOMM_MANCHESTER_THR, &conf);
+			if(bits[i] == IRCOMM_CODEC_NO_BIT) {
+				return i;
+			}
+		}
+		return 2;
+	}
+	irCommRemoveMean(signal, IRCOMM_SAMPLING_WINDOW);
+	power0 = irCommGoertzelPower(signal, IRCOMM_SAMPLING_WINDOW, IRCOMM_GOERTZEL_COEFF_BIT0);
+	power1 = irCommGoertzelPower(signal, IRCOMM_SAMPLING_WINDOW, IRCOMM_GOERTZEL_COEFF_BIT1);
+	if(irCommBitConfidence(power0, power1) < IRCOMM_GOERTZEL_MIN_CONF) {
+		return 0;
+	}
+	bits[0] = (power0 > power1) ? 0 : 1;
+	return 1;
+}
+
+// read the next valid record, returns 0 at the end of the file
+int readRecord(FILE *f, unsigned char *type, unsigned char *payload, unsigned int *len, unsigned long int *crcFailures) {
+	int c = 0, prev = -1;
+	unsigned char header[4];
+	unsigned char crc = 0;
+	unsigned int i = 0;
+
+	while((c = fgetc(f)) != EOF) {
+		if(prev==IRCOMM_CAPTURE_SYNC0 && c==IRCOMM_CAPTURE_SYNC1) {
+			if(fread(header, 1, 4, f) != 4) {
+				return 0;
+			}
+			*type = header[1];
+			*len = header[2] | (header[3]<<8);
+			if(header[0]!=IRCOMM_CAPTURE_VERSION || *len>MAX_PAYLOAD) {
+				prev = -1;
+				continue;
+			}
+			if(fread(payload, 1, *len, f) != *len || (c = fgetc(f)) == EOF) {
+				return 0;
+			}
+			crc = 0;
+			for(i=0; i<4; i++) {
+				crc = crc8(crc, header[i]);
+			}
+			for(i=0; i<*len; i++) {
+				crc = crc8(crc, payload[i]);
+			}
+			if(crc == c) {
+				return 1;
+			}
+			(*crcFailures)++;		// corrupted record, look for the next one
+			prev = -1;
+			continue;
+		}
+		prev = c;
+	}
+	return 0;
+}
+
+int replay(const char *fileName) {
+	FILE *f = fopen(fileName, "rb");
+	unsigned char payload[MAX_PAYLOAD], type = 0, lineCode = 0, sensor = 0, numSensors = 0, bitCount = 0, decided = 0;
+	unsigned char rxBits[12], valid[12], bits[2], byte = 0, ones = 0, diff = 0;
+	signed int samples[IRCOMM_SAMPLING_WINDOW];
+	unsigned int len = 0, i = 0;
+	unsigned long int recordCrcFailures = 0;
+	ReplayStats stats[2];
+	int c = 0, failed = 0;
+
+	if(f == NULL) {
+		printf("cannot open %s\n", fileName);
+		return 2;
+	}
+	memset(stats, 0, sizeof(stats));
+	memset(valid, 0, sizeof(valid));
+
+	while(readRecord(f, &type, payload, &len, &recordCrcFailures)) {
+		if(type == IRCOMM_CAPTURE_BIT) {
+			lineCode = payload[2]&0x01;
+			sensor = payload[3]&0x07;
+			bitCount = payload[4];
+			numSensors = payload[7];
+			if(bitCount>=10 || len<(unsigned int)(8+numSensors*IRCOMM_SAMPLING_WINDOW*2)) {
+				continue;
+			}
+			for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {	// samples of the selected sensor
+				c = (numSensors==8) ? (i*8+sensor) : i;
+				samples[i] = payload[8+2*c] | (payload[9+2*c]<<8);
+			}
+			decided = decodeWindow(lineCode, samples, bits);
+			stats[lineCode].windows++;
+			if(decided < ((lineCode==IRCOMM_CODE_MANCHESTER)?2:1)) {
+				stats[lineCode].undecided++;
+			}
+			for(i=0; i<decided && bitCount+i<10; i++) {
+				rxBits[bitCount+i] = bits[i];
+				valid[bitCount+i] = 1;
+			}
+		} else if(type == IRCOMM_CAPTURE_BYTE) {
+			if(payload[4] != 0) {		// the robot got a crc error, no reference byte
+				stats[lineCode].robotCrcErrors++;
+			} else {
+				stats[lineCode].bytes++;
+				byte = 0;
+				ones = 0;
+				for(i=0; i<10; i++) {
+					if(!valid[i]) {
+						break;
+					}
+					if(i < 8) {
+						byte = (byte<<1) | rxBits[i];
+						ones += rxBits[i];
+					}
+				}
+				if(i < 10) {			// the replay dropped the byte
+					stats[lineCode].byteErrors++;
+					stats[lineCode].bitErrors += 10-i;
+				} else {
+					if(((ones + (rxBits[8]<<1) + rxBits[9])&0x03) != 0) {
+						stats[lineCode].crcErrors++;
+					}
+					if(byte != payload[3]) {
+						stats[lineCode].byteErrors++;
+						for(diff = byte^payload[3]; diff; diff >>= 1) {
+							stats[lineCode].bitErrors += diff&0x01;
+						}
+					}
+				}
+			}
+			memset(valid, 0, sizeof(valid));
+		}
+	}
+	fclose(f);
+
+	printf("corrupted records skipped: %lu\n", recordCrcFailures);
+	for(c=0; c<2; c++) {
+		if(stats[c].windows == 0) {
+			continue;
+		}
+		printf("%s: %lu windows (%lu undecided), %lu bytes compared: %lu wrong (%lu bits), %lu crc errors; robot crc errors %lu\n",
+			(c==IRCOMM_CODE_MANCHESTER) ? "Manchester" : "frequency", stats[c].windows, stats[c].undecided, stats[c].bytes,
+			stats[c].byteErrors, stats[c].bitErrors, stats[c].crcErrors, stats[c].robotCrcErrors);
+		if(stats[c].byteErrors > 0) {
+			failed = 1;
+		}
+	}
+	return failed;
+}
+
+void writeRecord(FILE *f, unsigned char type, unsigned char *payload, unsigned int len) {
+	unsigned char header[4] = {IRCOMM_CAPTURE_VERSION, type, len&0xFF, len>>8};
+	unsigned char crc = 0;
+	unsigned int i = 0;
+
+	fputc(IRCOMM_CAPTURE_SYNC0, f);
+	fputc(IRCOMM_CAPTURE_SYNC1, f);
+	for(i=0; i<4; i++) {
+		crc = crc8(crc, header[i]);
+	}
+	for(i=0; i<len; i++) {
+		crc = crc8(crc, payload[i]);
+	}
+	fwrite(header, 1, 4, f);
+	fwrite(payload, 1, len, f);
+	fputc(crc, f);
+}
+
+int generate(const char *fileName) {
+	FILE *f = fopen(fileName, "wb");
+	SimChannel ch;
+	unsigned char payload[MAX_PAYLOAD], bits[10], code = 0, byte = 0, ones = 0, crc = 0, step = 0;
+	signed int samples[IRCOMM_SAMPLING_WINDOW], min = 0, max = 0;
+	int n = 0, b = 0, i = 0;
+
+	if(f == NULL) {
+		printf("cannot create %s\n", fileName);
+		return 2;
+	}
+	simInit(&ch, 42);
+	ch.numTx = 1;
+	ch.tx[0].distance = 2;
+	ch.tx[0].angle = 0;
+	for(n=0; n<SYNTH_BYTES; n++) {
+		code = n%2;
+		step = (code==IRCOMM_CODE_MANCHESTER) ? 2 : 1;
+		byte = (unsigned char)(simRandom(&ch)*255);
+		ones = 0;
+		for(b=0; b<8; b++) {
+			bits[b] = (byte>>(7-b))&0x01;
+			ones += bits[b];
+		}
+		crc = 4 - ones%4;		// as the transmitter (irCommunication.c)
+		bits[8] = (crc>>1)&0x01;
+		bits[9] = crc&0x01;
+		ch.tx[0].lineCode = code;
+		for(b=0; b<10; b+=step) {
+			memset(ch.tx[0].bits, 0, SIM_TX_BITS);
+			for(i=0; i<step; i++) {
+				ch.tx[0].bits[i] = bits[b+i];
+			}
+			ch.tx[0].offset = -(int)(simRandom(&ch)*4);
+			simReceiveWindow(&ch, samples);
+			min = 1024;
+			max = 0;
+			for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+				if(min > samples[i]) {
+					min = samples[i];
+				}
+				if(max < samples[i]) {
+					max = samples[i];
+				}
+				payload[8+2*i] = samples[i]&0xFF;
+				payload[9+2*i] = samples[i]>>8;
+			}
+			payload[0] = payload[1] = 0;
+			payload[2] = code;
+			payload[3] = 0;
+			payload[4] = b;
+			payload[5] = (max-min)&0xFF;
+			payload[6] = (max-min)>>8;
+			payload[7] = 1;
+			writeRecord(f, IRCOMM_CAPTURE_BIT, payload, 8+IRCOMM_SAMPLING_WINDOW*2);
+		}
+		payload[0] = payload[1] = 0;
+		payload[2] = 0;
+		payload[3] = byte;
+		payload[4] = 0;
+		payload[5] = 100;
+		writeRecord(f, IRCOMM_CAPTURE_BYTE, payload, 6);
+	}
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc==3 && strcmp(argv[1], "-g")==0) {
+		return generate(argv[2]);
+	}
+	if(argc == 2) {
+		return replay(argv[1]);
+	}
+	printf("usage: irReplay capture.bin | irReplay -g capture.bin\n");
+	return 2;
+}
@@ -0,0 +1,51 @@
+
+// Accuracy of the fixed-point atan2 (cordic.c) compared to the floating point one, sweeping the whole
+// circle at the magnitudes of the accelerometer values.
+
+#include <stdio.h>
+#include <math.h>
+#include "cordic.h"
+
+#define MAX_ERR_Q12_DEG 0.05		// maximum error of the Q12 angle (degrees)
+#define MAX_ERR_DEG 0.6				// maximum error after the rounding to integer degrees
+
+int main() {
+	const int radius[] = {16, 64, 128, 256, 512};
+	double maxErrQ12 = 0, maxErrDeg = 0, ref = 0, err = 0;
+	int r = 0, step = 0, x = 0, y = 0;
+
+	for(r=0; r<(int)(sizeof(radius)/sizeof(radius[0])); r++) {
+		for(step=0; step<3600; step++) {	// 0.1 degrees steps
+			x = (int)lround(radius[r]*cos(step*M_PI/1800));
+			y = (int)lround(radius[r]*sin(step*M_PI/1800));
+			if(x==0 && y==0) {
+				continue;
+			}
+			ref = atan2(y, x)*180/M_PI;
+
+			err = fabs(atan2Q12(y, x)*180.0/M_PI/4096 - ref);
+			if(err > 180) {		// -180 and 180 are the same angle
+				err = 360 - err;
+			}
+			if(err > maxErrQ12) {
+				maxErrQ12 = err;
+			}
+
+			err = fabs(radQ12ToDeg(atan2Q12(y, x)) - ref);
+			if(err > 180) {
+				err = 360 - err;
+			}
+			if(err > maxErrDeg) {
+				maxErrDeg = err;
+			}
+		}
+	}
+
+	printf("atan2Q12 max error: %.3f deg (Q12), %.3f deg (rounded to degrees)\n", maxErrQ12, maxErrDeg);
+	if(maxErrQ12>MAX_ERR_Q12_DEG || maxErrDeg>MAX_ERR_DEG) {
+		printf("FAIL\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,198 @@
+
+// Bit error rate of the IR decoding (irCommCodec.c) over the simulated channel (irChannelSim.c): one robot
+// transmits to the receiving sensor at increasing distances while other robots, not synchronized, transmit
+// at random from other directions. A bit counts as an error when it is wrong or cannot be decided (the robot
+// drops the byte in both cases). The frequency and Manchester line codes are compared on the same channel;
+// the Manchester code carries two bits per window instead of one.
+// The transmitters also emit the IR pulses of the proximity samples taken while transmitting; their effect is
+// compared between pulses on a sensor not used by the transmission (the firmware) and on a transmitting one,
+// and the resulting proximity update rate during the transmission is reported.
+// Only the bit decoding is exercised: irCommTasks and the adc sequences aren't run, so there are no figures of
+// throughput or latency (see irChannelSim.h).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "irCommCodec.h"
+#include "irChannelSim.h"
+
+#define WINDOWS 2000					// windows simulated for each point
+#define SYNC_JITTER 6					// maximum synchronization error of the receiver (ticks)
+#define MAX_BER_CLOSE 0.01				// maximum bit error rate accepted at 2 cm without interferers
+#define PULSE_GAIN_OTHER 0.71			// pulse of a sensor not transmitting: emitter 45 degrees away from the receiver (cos 45)
+#define PULSE_GAIN_TX 1.0				// pulse of a transmitting sensor
+#define TX_FREE_SENSORS 4				// sensors not used by a transmission with all the sensors (two groups of 4)
+
+// the same steps of the firmware (irCommunication.c, state IRCOMM_RX_READ_BIT) on one sensor
+unsigned char decodeFrequencyWindow(signed int *samples) {
+	signed int signal[IRCOMM_SAMPLING_WINDOW];
+	signed int min = 1024, max = 0;
+	signed long int power0 = 0, power1 = 0;
+	int i = 0;
+
+	for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+		signal[i] = samples[i];
+		if(min > signal[i]) {
+			min = signal[i];
+		}
+		if(max < signal[i]) {
+			max = signal[i];
+		}
+	}
+	if((max-min) < IRCOMM_DETECTION_AMPLITUDE_THR) {
+		return IRCOMM_CODEC_NO_BIT;
+	}
+	irCommRemoveMean(signal, IRCOMM_SAMPLING_WINDOW);
+	power0 = irCommGoertzelPower(signal, IRCOMM_SAMPLING_WINDOW, IRCOMM_GOERTZEL_COEFF_BIT0);
+	power1 = irCommGoertzelPower(signal, IRCOMM_SAMPLING_WINDOW, IRCOMM_GOERTZEL_COEFF_BIT1);
+	if(irCommBitConfidence(power0, power1) < IRCOMM_GOERTZEL_MIN_CONF) {
+		return IRCOMM_CODEC_NO_BIT;
+	}
+	return (power0 > power1) ? 0 : 1;
+}
+
+// the same steps of the firmware (irCommRxReadManchesterBits) on one sensor; returns the number of bits decided
+unsigned char decodeManchesterWindow(signed int *samples, unsigned char *bits) {
+	signed int min = 1024, max = 0;
+	unsigned char conf = 0;
+	int i = 0, j = 0;
+
+	for(i=0; i<IRCOMM_SAMPLING_WINDOW; i++) {
+		if(min > samples[i]) {
+			min = samples[i];
+		}
+		if(max < samples[i]) {
+			max = samples[i];
+		}
+	}
+	if((max-min) < IRCOMM_DETECTION_AMPLITUDE_THR) {
+		return 0;
+	}
+	for(j=0; j<2; j++) {
+		bits[j] = irCommDecodeManchesterBit(&samples[j*(IRCOMM_SAMPLING_WINDOW/2)], IRCOMM_SAMPLING_WINDOW/4, max-min, IRCOMM_MANCHESTER_THR, &conf);
+		if(bits[j] == IRCOMM_CODEC_NO_BIT) {
+			return j;
+		}
+	}
+	return 2;
+}
+
+void randomBits(SimChannel *ch, SimTransmitter *tx) {
+	int i = 0;
+	for(i=0; i<SIM_TX_BITS; i++) {
+		tx->bits[i] = (simRandom(ch) < 0.5) ? 0 : 1;
+	}
+}
+
+// bit error rate of a line code with the transmitter at some distance and some interferers
+double bitErrorRate(unsigned char lineCode, double distance, int interferers, double pulseGain, unsigned long int seed) {
+	SimChannel ch;
+	signed int samples[IRCOMM_SAMPLING_WINDOW];
+	unsigned char bit = 0, rxBits[2], decided = 0;
+	int w = 0, k = 0, j = 0, errors = 0, bits = 0;
+
+	simInit(&ch, seed);
+	ch.numTx = 1 + interferers;
+	for(w=0; w<WINDOWS; w++) {
+		ch.tx[0].distance = distance;
+		ch.tx[0].angle = 0;
+		ch.tx[0].lineCode = lineCode;
+		ch.tx[0].offset = -(int)(simRandom(&ch)*SYNC_JITTER);
+		ch.tx[0].pulseGain = pulseGain;
+		ch.tx[0].pulsePhase = (int)(simRandom(&ch)*SIM_INTERLEAVE_TICKS);
+		randomBits(&ch, &ch.tx[0]);
+		for(k=1; k<ch.numTx; k++) {		// other robots around, 3..8 cm from the sensor, from any direction in front of it
+			ch.tx[k].distance = 3 + simRandom(&ch)*5;
+			ch.tx[k].angle = -80 + simRandom(&ch)*160;
+			ch.tx[k].lineCode = lineCode;
+			ch.tx[k].offset = -(int)(simRandom(&ch)*SIM_WINDOW_TICKS);
+			ch.tx[k].pulseGain = pulseGain;
+			ch.tx[k].pulsePhase = (int)(simRandom(&ch)*SIM_INTERLEAVE_TICKS);
+			randomBits(&ch, &ch.tx[k]);
+		}
+		simReceiveWindow(&ch, samples);
+
+		if(lineCode == IRCOMM_CODE_MANCHESTER) {
+			decided = decodeManchesterWindow(samples, rxBits);
+			for(j=0; j<2; j++) {
+				if((j >= decided) || (rxBits[j] != ch.tx[0].bits[j])) {
+					errors++;
+				}
+				bits++;
+			}
+		} else {
+			bit = decodeFrequencyWindow(samples);
+			if(bit != ch.tx[0].bits[0]) {
+				errors++;
+			}
+			bits++;
+		}
+	}
+	return (double)errors/bits;
+}
+
+// proximity samples per second taken while transmitting, from the samples sequence of the simulator
+double proxSamplesRate(unsigned char lineCode) {
+	SimChannel ch;
+	int w = 0, count = 0, total = 0;
+
+	simInit(&ch, 99);
+	for(w=0; w<WINDOWS; w++) {
+		ch.tx[0].lineCode = lineCode;
+		ch.tx[0].pulsePhase = (int)(simRandom(&ch)*SIM_INTERLEAVE_TICKS);
+		randomBits(&ch, &ch.tx[0]);
+		simTxPulseOn(&ch.tx[0], 2*SIM_WINDOW_TICKS-1, &count);
+		total += count;
+	}
+	return total/(WINDOWS*2*SIM_WINDOW_TICKS*0.000104);
+}
+
+int main() {
+	const double distances[] = {1, 2, 3, 4, 5, 6, 7};
+	const int interferers[] = {0, 1, 3};
+	const unsigned char codes[] = {IRCOMM_CODE_FREQUENCY, IRCOMM_CODE_MANCHESTER};
+	const char *names[] = {"frequency (1 bit/window)", "Manchester (2 bits/window)"};
+	int c = 0, d = 0, n = 0, failed = 0;
+	double ber = 0;
+
+	for(c=0; c<2; c++) {
+		printf("%s line code, bit error rate (wrong or undecided bits)\n", names[c]);
+		printf("distance [cm]");
+		for(n=0; n<3; n++) {
+			printf("  %d other robots", interferers[n]);
+		}
+		printf("\n");
+		for(d=0; d<7; d++) {
+			printf("%13.0f", distances[d]);
+			for(n=0; n<3; n++) {
+				ber = bitErrorRate(codes[c], distances[d], interferers[n], PULSE_GAIN_OTHER, 1234+d*10+n);	// same channel for both codes
+				printf("  %14.4f", ber);
+				if(distances[d]==2 && interferers[n]==0 && ber>MAX_BER_CLOSE) {
+					failed = 1;
+				}
+			}
+			printf("\n");
+		}
+		printf("\n");
+	}
+
+	for(c=0; c<2; c++) {
+		printf("%s line code, proximity pulses while transmitting (no other robots)\n", names[c]);
+		printf("distance [cm]  no pulses  other sensor  transmitting sensor\n");
+		for(d=0; d<7; d++) {
+			printf("%13.0f  %9.4f  %12.4f  %19.4f\n", distances[d],
+				bitErrorRate(codes[c], distances[d], 0, 0, 1234+d*10),
+				bitErrorRate(codes[c], distances[d], 0, PULSE_GAIN_OTHER, 1234+d*10),
+				bitErrorRate(codes[c], distances[d], 0, PULSE_GAIN_TX, 1234+d*10));
+		}
+		ber = proxSamplesRate(codes[c]);
+		printf("proximity samples while transmitting: %.0f/s, update of the %d sensors not transmitting: %.1f Hz\n\n",
+			ber, TX_FREE_SENSORS, ber/(2*TX_FREE_SENSORS));
+	}
+
+	if(failed) {
+		printf("FAIL\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,281 @@
+// Aseba transport through the radio (rfAseba.c) against a stand-in of the computer side (bridge): the bridge
+// splits the Aseba messages in frames of PAYLOAD_SIZE bytes, sends each fragment until it is acknowledged and
+// reassembles the fragments of the robot carried by the ack payloads. The radio is modelled as the nRF24L01:
+// the ack of a frame carries the payload loaded before the frame was received, so the answer to a frame is
+// received with the ack of the next one. Frames and acks can be lost (the bridge then sends the frame again,
+// that is a duplicate for the robot if only the ack was lost).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rfAseba.h"
+
+#define STREAM_MAX 8192
+#define MAX_EXCHANGES 200000
+
+typedef struct {
+	unsigned char out[STREAM_MAX];		// stream to the robot
+	int outLen;
+	int outPos;							// bytes acknowledged by the robot
+	int fragLen;						// size of the fragment being sent (0 = none)
+	unsigned char txSeq;
+	unsigned char in[STREAM_MAX];		// stream received from the robot
+	int inLen;
+	unsigned char rxSeq;
+	int exchanges;
+} Bridge;
+
+Bridge bridge;
+unsigned char radioAck[ACK_PAYLOAD_SIZE];	// ack payload loaded in the radio
+unsigned char radioAckLen = 0;
+unsigned long int lossSeed = 1;
+int frameLossPercent = 0;
+int ackLossPercent = 0;
+unsigned long int now = 0;
+int failures = 0;
+
+// functions of the firmware used by rfAseba.c
+void writeAckPayload(unsigned char *data, unsigned char size) {
+	memcpy(radioAck, data, size);
+	radioAckLen = size;
+}
+
+unsigned long int getTime100MicroSec() {
+	return now;
+}
+
+void bridgeStep();
+
+void rfTasks() {	// the robot waits for space in its tx buffer, the frames keep coming
+	bridgeStep();
+}
+
+void check(int condition, const char *what) {
+	if(!condition) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+int lost(int percent) {
+	lossSeed = lossSeed*1103515245 + 12345;
+	return (int)((lossSeed>>16)%100) < percent;
+}
+
+// one frame through the radio; returns 1 and the ack payload if the ack is received
+int radioExchange(unsigned char *frame, unsigned char *reply, unsigned char *replyLen) {
+	now += 10;	// 1 ms between frames
+	bridge.exchanges++;
+	if(lost(frameLossPercent)) {
+		return 0;
+	}
+	memcpy(reply, radioAck, radioAckLen);	// the ack is sent by the radio before the robot handles the frame
+	*replyLen = radioAckLen;
+	rfAsebaHandleFrame(frame);
+	if(lost(ackLossPercent)) {
+		return 0;
+	}
+	return 1;
+}
+
+void bridgeReset() {
+	unsigned char frame[PAYLOAD_SIZE], reply[ACK_PAYLOAD_SIZE], replyLen = 0;
+	memset(&bridge, 0, sizeof(bridge));
+	memset(frame, 0, sizeof(frame));
+	frame[0] = RF_ASEBA_FRAME | RF_ASEBA_FLAG_RESET;
+	frame[1] = bridge.txSeq;	// sequence preceding the first fragment
+	while(radioExchange(frame, reply, &replyLen) == 0);
+}
+
+void bridgeReply(unsigned char *reply, unsigned char replyLen) {
+	if((replyLen < RF_ASEBA_HEADER_SIZE) || ((reply[0]&0xF0) != RF_ASEBA_FRAME)) {
+		return;
+	}
+	if((bridge.fragLen > 0) && (reply[2] == bridge.txSeq)) {
+		bridge.outPos += bridge.fragLen;
+		bridge.fragLen = 0;
+	}
+	if((reply[0] & RF_ASEBA_FLAG_DATA) && (reply[1] == (unsigned char)(bridge.rxSeq+1))) {
+		memcpy(&bridge.in[bridge.inLen], &reply[RF_ASEBA_HEADER_SIZE], reply[3]);
+		bridge.inLen += reply[3];
+		bridge.rxSeq = reply[1];
+	}
+}
+
+void bridgeStep() {
+	unsigned char frame[PAYLOAD_SIZE], reply[ACK_PAYLOAD_SIZE], replyLen = 0;
+
+	if((bridge.fragLen == 0) && (bridge.outPos < bridge.outLen)) {
+		bridge.fragLen = bridge.outLen - bridge.outPos;
+		if(bridge.fragLen > RF_ASEBA_DOWN_DATA) {
+			bridge.fragLen = RF_ASEBA_DOWN_DATA;
+		}
+		bridge.txSeq++;
+	}
+	memset(frame, 0, sizeof(frame));
+	frame[0] = RF_ASEBA_FRAME;
+	frame[1] = bridge.txSeq;
+	frame[2] = bridge.rxSeq;
+	if(bridge.fragLen > 0) {
+		frame[0] |= RF_ASEBA_FLAG_DATA;
+		frame[3] = bridge.fragLen;
+		memcpy(&frame[RF_ASEBA_HEADER_SIZE], &bridge.out[bridge.outPos], bridge.fragLen);
+	}
+	if(radioExchange(frame, reply, &replyLen)) {
+		bridgeReply(reply, replyLen);
+	}
+}
+
+// Aseba message on the stream: length (type excluded), source, type, data; all little endian
+void bridgeQueueMessage(unsigned int type, unsigned int source, unsigned char *data, unsigned int len) {
+	unsigned char *p = &bridge.out[bridge.outLen];
+	p[0] = len&0xFF;
+	p[1] = len>>8;
+	p[2] = source&0xFF;
+	p[3] = source>>8;
+	p[4] = type&0xFF;
+	p[5] = type>>8;
+	memcpy(&p[6], data, len);
+	bridge.outLen += len+6;
+}
+
+void fillPattern(unsigned char *data, unsigned int len, unsigned int seed) {
+	unsigned int i = 0;
+	for(i=0; i<len; i++) {
+		data[i] = (unsigned char)(seed*31 + i*7 + (i>>8));
+	}
+}
+
+// sends the messages of the given sizes and reads them on the robot, consuming each one as soon as complete
+// when "consume" is set, otherwise only when the bridge is stalled because the robot buffer is full (flow control)
+void sendMessages(const unsigned int *sizes, int num, int consume, const char *name) {
+	unsigned char sent[1100], received[1100];
+	unsigned int source = 0, len = 0;
+	int i = 0, next = 0, ok = 1, stalled = 0, lastPos = 0;
+
+	for(i=0; i<num; i++) {
+		fillPattern(sent, sizes[i], i);
+		bridgeQueueMessage(0x9000+i, 100+i, sent, sizes[i]);
+	}
+	while(next < num && bridge.exchanges < MAX_EXCHANGES) {
+		bridgeStep();
+		if(bridge.outPos == lastPos) {
+			stalled++;
+		} else {
+			stalled = 0;
+			lastPos = bridge.outPos;
+		}
+		if(consume || stalled > 20 || bridge.outPos == bridge.outLen) {
+			len = rfAsebaGetMessage(received, sizeof(received), &source);
+			if(len > 0) {
+				fillPattern(sent, sizes[next], next);
+				if((len != sizes[next]+2) || (source != (unsigned int)(100+next)) ||
+					(received[0] != ((0x9000+next)&0xFF)) || (received[1] != ((0x9000+next)>>8)) ||
+					(memcmp(&received[2], sent, sizes[next]) != 0)) {
+					ok = 0;
+				}
+				next++;
+			}
+		}
+	}
+	printf("%s: %d/%d messages, %d frames\n", name, next, num, bridge.exchanges);
+	check(ok && next == num, name);
+}
+
+int main() {
+	const unsigned int small[] = {0, 3, 9, 10, 40};
+	const unsigned int big[] = {300, 516, 257};			// longer than the old 256 bytes buffer
+	unsigned int wrap[40];
+	unsigned char data[600];
+	unsigned char frame[PAYLOAD_SIZE], reply[ACK_PAYLOAD_SIZE], replyLen = 0;
+	unsigned int source = 0;
+	int i = 0;
+
+	// messages of different sizes on a perfect link
+	bridgeReset();
+	sendMessages(small, 5, 1, "small messages");
+
+	// one-frame ack lag: the first answer to a new fragment still acknowledges the previous one
+	bridgeReset();
+	data[0] = 1;
+	bridgeQueueMessage(0x9000, 1, data, 1);
+	bridgeStep();
+	check(bridge.fragLen > 0 && bridge.outPos == 0, "fragment acknowledged before the robot got it");
+	bridgeStep();
+	check(bridge.fragLen == 0 && bridge.outPos == 7, "fragment acknowledged with the answer to the next frame");
+	check(rfAsebaGetMessage(data, sizeof(data), &source) == 3, "one byte message");
+
+	// duplicated frame: the fragment is stored once
+	bridgeReset();
+	fillPattern(data, 3, 0);
+	bridgeQueueMessage(0x9000, 100, data, 3);
+	bridge.fragLen = 9;
+	bridge.txSeq = 1;
+	memset(frame, 0, sizeof(frame));
+	frame[0] = RF_ASEBA_FRAME | RF_ASEBA_FLAG_DATA;
+	frame[1] = 1;
+	frame[3] = 9;
+	memcpy(&frame[RF_ASEBA_HEADER_SIZE], bridge.out, 9);
+	radioExchange(frame, reply, &replyLen);
+	radioExchange(frame, reply, &replyLen);
+	check(((rfAsebaRxHead-rfAsebaRxTail)&(RF_ASEBA_RX_BUFF_SIZE-1)) == 9, "duplicated frame stored once");
+	bridgeReply(reply, replyLen);
+	check(bridge.outPos == 9, "duplicated frame acknowledged");
+	check(rfAsebaGetMessage(data, sizeof(data), &source) == 5, "message after a duplicated frame");
+
+	// messages longer than 256 bytes, up to ASEBA_MAX_INNER_PACKET_SIZE (512) + length and source
+	bridgeReset();
+	sendMessages(big, 3, 1, "long messages");
+
+	// the rx buffer (1024 bytes) wraps many times, with messages across the end of the buffer
+	bridgeReset();
+	for(i=0; i<40; i++) {
+		wrap[i] = 97 + (i*53)%200;
+	}
+	sendMessages(wrap, 40, 1, "rx buffer wrap");
+
+	// the robot doesn't read the messages: the fragments that don't fit aren't acknowledged
+	bridgeReset();
+	sendMessages(big, 3, 0, "flow control");
+
+	// lost frames and acks (duplicates for the robot)
+	bridgeReset();
+	frameLossPercent = 20;
+	ackLossPercent = 20;
+	sendMessages(wrap, 40, 1, "20% frames and acks lost");
+
+	// reset in the middle of a message: the partial message is discarded and the link restarts
+	frameLossPercent = 0;
+	ackLossPercent = 0;
+	bridgeReset();
+	fillPattern(data, 300, 0);
+	bridgeQueueMessage(0x9000, 100, data, 300);
+	for(i=0; i<10; i++) {
+		bridgeStep();
+	}
+	check(rfAsebaGetMessage(data, sizeof(data), &source) == 0, "partial message");
+	bridgeReset();
+	check(rfAsebaRxHead == rfAsebaRxTail, "reset empties the rx buffer");
+	sendMessages(small, 5, 1, "messages after a reset");
+
+	// robot to computer: a message longer than the tx buffer, the robot waits for the frames (rfTasks)
+	bridgeReset();
+	frameLossPercent = 10;
+	ackLossPercent = 10;
+	fillPattern(data, 500, 7);
+	for(i=0; i<500; i++) {
+		rfAsebaSendByte(data[i]);
+	}
+	while(bridge.inLen < 500 && bridge.exchanges < MAX_EXCHANGES) {
+		bridgeStep();
+	}
+	printf("robot to computer: %d/500 bytes, %d frames\n", bridge.inLen, bridge.exchanges);
+	check(bridge.inLen == 500 && memcmp(bridge.in, data, 500) == 0, "robot to computer");
+
+	if(failures) {
+		printf("FAIL\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -32,7 +32,7 @@
 #endif
 
 /* I2C clock in Hz */
-#define SCL_CLOCK  440000L
+#define SCL_CLOCK  100000L
 
 void i2c_close() {
 	TWBR = 0x00;
@@ -55,6 +55,20 @@ void i2c_init(void)
 }/* i2c_init */
 
 
+/*************************************************************************
+ Change the I2C clock at runtime (e.g. to switch to fast mode once the
+ devices on the bus are known to support it).
+ Must be called when the bus is idle (after i2c_stop).
+ 
+ Input:   desired SCL clock in Hz
+*************************************************************************/
+void i2c_set_clock(unsigned long sclClock)
+{
+  TWBR = ((F_CPU/sclClock)-16)/2;   /* TWPS = 0 => prescaler = 1 */
+
+}/* i2c_set_clock */
+
+
 /*************************************************************************	
   Issues a start condition and sends address and transfer direction.
   return 0 = device accessible, 1= failed to access device
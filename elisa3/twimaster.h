@@ -102,6 +102,14 @@
 extern void i2c_init(void);
 
 
+/**
+ @brief change the I2C clock at runtime; the bus must be idle
+ @param  sclClock desired SCL clock in Hz (e.g. 100000 or 400000)
+ @return none
+ */
+extern void i2c_set_clock(unsigned long sclClock);
+
+
 /** 
  @brief Terminates the data transfer and releases the I2C bus 
  @param void
@@ -1,6 +1,15 @@
 
 #include "utility.h"
 
+// executed at startup before the variables initialization: the reset flags are saved and the watchdog,
+// that remains enabled after a watchdog reset, is disabled before it expires again
+void saveResetFlags(void) __attribute__((naked)) __attribute__((section(".init3")));
+void saveResetFlags(void) {
+	mcusrMirror = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
+
 unsigned char getSelector() {
    return (SEL0) + 2*(SEL1) + 4*(SEL2) + 8*(SEL3);
 }
@@ -48,16 +57,39 @@ void initPeripherals(void) {
 	mirf_init();
 	if(spiCommError==0) {
 		rfFlags |= 1;
+		rfPollEnabled = 1;
 	}
 	initUsart0();
 	initAccelerometer();
 	init_ir_remote_control();
+	blackBoxInit();
 
 	sei();			// enable global interrupts
 
 	
 }
 
+void idleSleep() {
+	cli();		// the checks and the sleep instruction must not be interrupted
+	if((byteCount==0) && (rfDataReady==0)) {
+		cpuSleeping = 1;
+		SMCR = (1 << SE);	// idle mode
+		sei();				// the instruction following sei is executed before any interrupt
+		__asm__("sleep");
+		SMCR = 0x00;
+		cpuSleeping = 0;
+	}
+	sei();
+}
+
+unsigned char getIdlePercent() {
+	unsigned int ticks = 0;
+	cli();
+	ticks = idleTicksLast;
+	sei();
+	return (unsigned long int)ticks*100/IDLE_MEASURE_PERIOD;
+}
+
 // used only for wake-up from sleep
 ISR(TIMER2_OVF_vect) {
 
@@ -147,14 +179,62 @@ unsigned long int getTime100MicroSec() {
 	return clockTick;
 }
 
+unsigned long int getGlobalTime() {
+	unsigned long int local = getTime100MicroSec();
+	unsigned long int elapsed = 0;
+
+	if(rfTimeSyncState == RF_TIME_NOT_SYNC) {
+		return local;
+	}
+	elapsed = local - rfTimeLastLocal;
+	if(elapsed > RF_TIME_MAX_ELAPSED) {
+		elapsed = RF_TIME_MAX_ELAPSED;
+	}
+	return local + rfTimeOffset + (((signed long int)(elapsed>>4) * rfTimeDriftQ16) >> 12);
+}
+
+unsigned char isGlobalTimeSynchronized() {
+	if((rfTimeSyncState != RF_TIME_NOT_SYNC) && ((getTime100MicroSec()-rfTimeLastLocal) < RF_TIME_SYNC_TIMEOUT)) {
+		return 1;
+	}
+	return 0;
+}
+
+unsigned long int ticksToMsec(unsigned long int ticks) {
+	return (ticks/125)*13 + ((ticks%125)*13)/125;	// 104 us = 13/125 ms, split to avoid overflows
+}
+
 void readBatteryLevel() {
 	measBattery = 1;
 }
 
+unsigned char crc8Update(unsigned char crc, unsigned char data) {
+	unsigned char i = 0;
+	crc ^= data;
+	for(i=0; i<8; i++) {
+		if(crc & 0x80) {
+			crc = (crc<<1) ^ 0x07;
+		} else {
+			crc = crc<<1;
+		}
+	}
+	return crc;
+}
+
+unsigned char crc8(unsigned char *data, unsigned char len) {
+	unsigned char crc = 0;
+	while(len--) {
+		crc = crc8Update(crc, *data++);
+	}
+	return crc;
+}
+
 void resetOdometry() {
 	leftMotSteps = 0;
 	rightMotSteps = 0;
 	theta = 0;
+	thetaFusedQ12 = 0;
+	thetaWheelPrevQ12 = 0;
 	xPos = 0;
 	yPos = 0;
 	rightDist = 0;
@@ -21,6 +21,7 @@
 #include <avr\interrupt.h>
 #include <avr\sleep.h>
 #include <avr\eeprom.h>
+#include <avr\wdt.h>
 #include "ports_io.h"
 #include "adc.h"
 #include "motors.h"
@@ -31,6 +32,8 @@
 #include "sensors.h"
 #include "ir_remote_control.h"
 #include "eepromIO.h"
+#include "blackBox.h"
+#include "cordic.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -55,6 +58,19 @@ void initPeripherals();
  */
 void sleep(unsigned char seconds);
 
+/**
+ * \brief Put the cpu in idle mode until the next interrupt (at most 104 us, the adc interrupt), unless
+ * data were received from the uart or the radio in the meantime. The peripherals keep running.
+ * \return none
+ */
+void idleSleep();
+
+/**
+ * \brief Get the fraction of time the cpu was in idle mode during the last second.
+ * \return idle time (percentage)
+ */
+unsigned char getIdlePercent();
+
 /**
  * \brief A global variable "clockTick" is incremented at each adc interrupt; this variable is
  * used as base time (104 us resolution). This function is useful for instance to create non-blocking delays, calling 
@@ -63,6 +79,26 @@ void sleep(unsigned char seconds);
  */
 unsigned long int getTime100MicroSec();
 
+/**
+ * \brief Get the time shared by all the robots, that is the robot time corrected with the offset and drift estimated
+ * from the time beacons broadcast through the radio; without beacons it is the robot time.
+ * \return the global time (104 us resolution)
+ */
+unsigned long int getGlobalTime();
+
+/**
+ * \brief Check whether the global time is synchronized (a time beacon was received within RF_TIME_SYNC_TIMEOUT).
+ * \return 1 if synchronized, 0 otherwise
+ */
+unsigned char isGlobalTimeSynchronized();
+
+/**
+ * \brief Convert a time expressed in clock ticks (104 us) to milliseconds.
+ * \param ticks clock ticks
+ * \return time in milliseconds
+ */
+unsigned long int ticksToMsec(unsigned long int ticks);
+
 /**
  * \brief Simply set the flag that indicates when the battery has to be read.
  * \return none
@@ -71,6 +107,22 @@ void readBatteryLevel();
 
 void resetOdometry();
 
+/**
+ * \brief Compute the CRC-8 (polynomial x^8+x^2+x+1, initial value 0) of a buffer.
+ * \param data buffer
+ * \param len number of bytes
+ * \return the CRC of the buffer
+ */
+unsigned char crc8(unsigned char *data, unsigned char len);
+
+/**
+ * \brief Update a CRC-8 (same polynomial of "crc8") with one more byte, to compute the CRC of data that aren't in a buffer.
+ * \param crc current CRC (0 at the beginning)
+ * \param data next byte
+ * \return the updated CRC
+ */
+unsigned char crc8Update(unsigned char crc, unsigned char data);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -23,6 +23,9 @@ int proximityResult[12] = {0};						// contains the calibrated values => ambient
 signed int proximityOffset[12] = {0};				// contains the calibration values
 unsigned long proximitySum[12] = {0};				// contains the sum of the sensor values during calibration (this value will then be divided by the number
 													// of samples taken to get the calibration offsets)
+signed long int proximityBaseline[8] = {0};			// proximity offsets tracked continuously when no obstacle is detected (Q8 format); they
+													// follow the ambient light drift and are copied in "proximityOffset"
+unsigned char proxBaselineEnabled = 1;				// enable/disable the tracking of the proximity offsets
 unsigned char adcSaveDataTo = 0;					// indicate where to save the currently sampled channel
 unsigned char adcSamplingState = 0;					// indicate which channel to select
 unsigned char rightChannelPhase = 0;				// right motor phase when the channel was selected
@@ -83,15 +86,47 @@ unsigned char firstSampleLeft = 1;
 unsigned int dataLED[3];							// array containing the value received through the radio
 signed int speedl=0, speedr=0;						// current speed for left and right motors received through the radio (absolute value)
 unsigned char rfData[PAYLOAD_SIZE];					// data received through the radio
-unsigned char ackPayload[16];						// data to send back to the base-station
+unsigned char ackPayload[ACK_PAYLOAD_SIZE];			// data to send back to the base-station
 unsigned char packetId = 3;
+unsigned char rfAckSchedule[RF_ACK_SCHEDULE_SIZE] = {3, 4, 5, 6, 7};	// packets sent back in rotation (the same packet can be repeated to be sent more often)
+unsigned char rfAckScheduleLen = 5;
+unsigned char rfAckScheduleIndex = 0;
+volatile unsigned char rfPollEnabled = 0;			// the radio status is read in background (spi interrupt)
+volatile unsigned char rfPollBusy = 0;				// a background status read is in progress
+volatile unsigned char rfDataReady = 0;				// data received, set by the background status read
+unsigned char rfPollCounter = 0;
+unsigned char rfGroupId = 0;							// group of the robot for the broadcast commands (0 = only the commands for all the robots)
+unsigned int rfGroupCmdSeq = 0xFFFF;					// sequence of the last broadcast command received (the same command can be repeated)
+unsigned char rfGroupCmdPending = 0;					// a broadcast command is waiting its execution time
+unsigned char rfGroupCmdType = 0;
+unsigned char rfGroupCmdIndex = 0;
+signed int rfGroupCmdValue = 0;
+unsigned long int rfGroupCmdTime = 0;					// execution time (global) of the pending broadcast command
+volatile unsigned long int rfDataReadyTime = 0;			// time at which the data received were detected by the background status read
+unsigned char rfTimeSyncState = RF_TIME_NOT_SYNC;
+signed long int rfTimeOffset = 0;						// global time - robot time at the last beacon
+signed long int rfTimeDriftQ16 = 0;						// (global - robot) / robot time rate, Q16 format
+unsigned long int rfTimeLastLocal = 0;					// robot time of the last beacon
+unsigned long int rfTimeLastMaster = 0;					// global time of the last beacon
 unsigned int rfAddress = 0;							// this number define the robot ID, used also as the robot
 													// RF address; from this number is then obtained the hardware revision
 unsigned char rfFlags = 0;							// bit0: 1 = spi comm. ok, 0 = spi comm. not ok
 													// bit1: 1 = rf comm. ok, 0 = rf comm. not ok
 unsigned char spiCommError=0;
 unsigned char rfDebugMode = 0;
+unsigned char rfLegacyCommandsEnabled = 0;			// decode the commands packets (motors, leds, ...) sent by the computer
 unsigned char rfDebugCounter = 0;
+unsigned char rfAsebaRxBuff[RF_ASEBA_RX_BUFF_SIZE];	// Aseba messages stream received through the radio (reassembled fragments)
+unsigned int rfAsebaRxHead = 0;
+unsigned int rfAsebaRxTail = 0;
+unsigned char rfAsebaTxBuff[RF_ASEBA_BUFF_SIZE];		// Aseba messages stream to send through the radio
+unsigned char rfAsebaTxHead = 0;
+unsigned char rfAsebaTxTail = 0;
+unsigned char rfAsebaRxSeq = 0;						// sequence number of the last fragment accepted from the computer
+unsigned char rfAsebaTxSeq = 0;						// sequence number of the fragment currently sent to the computer
+unsigned char rfAsebaTxLen = 0;						// size of the fragment currently sent (0 = none)
+unsigned char rfAsebaConnected = 0;					// 1 when a computer is exchanging Aseba frames with the robot
+unsigned long int rfAsebaLastFrameTime = 0;
 
 /****************/
 /*** RGB LEDS ***/
@@ -132,6 +167,7 @@ uint32_t lastCmdTime = 0;
 /*********************/
 unsigned char accelAddress = MMA7455L_ADDR;			// accelerometer I2C communication address
 unsigned char useAccel = USE_MMAX7455L;				// flag indicatin which accelerometer (or none) is active
+unsigned long accelI2cClock = I2C_CLOCK_STANDARD;	// I2C clock currently used with the accelerometer (chosen at startup by probing the device)
 signed int accX=0, accY=0, accZ=0;					// accelerometer calibrated values
 signed int accOffsetX = 0;							// values obtained during the calibration process; acc = raw_acc - offset
 signed int accOffsetY = 0;							// before calibration: values between -3g and +3g corresponds to values between 0 and 1024
@@ -155,6 +191,11 @@ uint32_t clockTick = 0;					// this is the base time, each tick corresponds to 1
 unsigned char currentSelector = 0;					// current selector position
 signed int calibrationCycle = 0;					// indicate how many samples are currently taken for calibration
 unsigned char startCalibration;						// flag indicating when a calibration is in progress
+unsigned char calibrationState = SENS_CALIB_STATE_IDLE;	// current state of the sensors calibration state machine
+unsigned char calibrationNext = SENS_CALIB_NEXT_NONE;	// action started when the sensors calibration finishes (remote control and radio commands)
+uint32_t calibrationTick = 0;						// time reference used by the sensors calibration state machine
+unsigned int calibrationCounter = 0;				// number of sensors calibrations saved in eeprom (there is no real time clock, thus 
+													// this progressive counter is used as timestamp of the saved calibration)
 unsigned char hardwareRevision = HW_REV_3_0;		// hardware revision based on the address saved in eeprom
 unsigned char currentOsccal;
 unsigned long long int speedStepCounter=0;
@@ -181,6 +222,10 @@ float theta=0.0, lastTheta=0.0, xPos=0.0, yPos=0.0, deltaDist=0.0;
 float leftDist = 0, rightDist = 0, leftDistPrev = 0, rightDistPrev = 0;
 unsigned char computeOdometry = 0;
 float thetaAcc = 0.0;
+signed int thetaAccQ12 = 0;							// orientation from the accelerometer (vertical wall), radians in Q12 format
+signed long int thetaFusedQ12 = 0;					// heading fused from wheels and accelerometer, radians in Q12 format (not wrapped)
+signed long int thetaWheelPrevQ12 = 0;				// heading given by the wheels at the previous odometry step, radians in Q12 format
+unsigned char headingConfidence = 0;				// confidence (0..100) of the heading given by the accelerometer
 unsigned char calibState;
 unsigned char calibVelIndex;
 unsigned char calibWheel;
@@ -211,9 +256,11 @@ int calibrationThr = 0;
 unsigned char irCommEnabled = IRCOMM_MODE_SENSORS_SAMPLING;
 unsigned char irCommEnabledNext = IRCOMM_MODE_SENSORS_SAMPLING;
 unsigned char irCommMode = IRCOMM_MODE_SENSORS_SAMPLING;
+unsigned char irCommLineCode = IRCOMM_CODE_FREQUENCY;	// line code used for the data bits (frequency or Manchester)
 volatile unsigned char irCommState = 0;
 unsigned int irCommTempValue = 0;
 volatile unsigned char irCommSendValues = 0;	// debug through uart
+unsigned char irCommCaptureCrc = 0;				// crc of the capture record being sent
 unsigned long int irCommTickCounter = 0;
 unsigned long int irCommTickCounter2 = 0;
 unsigned char irCommTickCounterUpdate = 0;
@@ -246,12 +293,16 @@ unsigned char irCommComputeShift = 0;
 signed int irCommProxMean = 0;
 signed char irCommSignalState = 0;
 unsigned char irCommSwitchCount = 0;
+signed long int irCommPowerBit0 = 0;				// power of the received signal at the bit "0" frequency (Goertzel)
+signed long int irCommPowerBit1 = 0;				// power of the received signal at the bit "1" frequency (Goertzel)
 unsigned char irCommRxBitCount = 0;
 unsigned char irCommRxCrcError = 0;
 unsigned char irCommRxByte = 0;
 unsigned char irCommSecondBitSkipped = 0;
 unsigned char irCommShiftCounter = 0;
 unsigned char irCommRxBitReceived[10];	// used for debug essentially
+unsigned char irCommRxBitConfidence[10];	// confidence (0..100) of each bit received, given by the Goertzel detector
+unsigned char irCommRxLastConfidence = 0;	// lowest bit confidence of the last byte received
 unsigned char irCommRxByteExpected = 0;	// debug
 unsigned char irCommRxSequenceCount = 0;	// debug
 unsigned char irCommRxLastDataReceived = 0;
@@ -264,23 +315,117 @@ unsigned char irCommRxStartPeakDuration = 0;
 signed int irCommRxMaxDiff = 0;
 signed int irCommRxMaxSensor = 0;
 unsigned char irCommRxNumReceivingSensors = 0;
+unsigned char irCommRxDiversityEnabled = 0;			// decide the bits combining all the sensors that perceive the signal
+unsigned int irCommRxSensorAmplitude[8];			// maximum signal amplitude of each sensor during the current byte reception
+unsigned int irCommRxSensorStrength[8];				// maximum signal amplitude of each sensor during the last byte received
+signed int irCommRxBearing = 0;						// direction of the sender of the last byte received (degrees, -180..180)
+unsigned int irCommRxDistance = 0;					// distance of the sender of the last byte received (mm)
+signed int irCommNeighbourId[IRCOMM_MAX_NEIGHBOURS] = {-1, -1, -1, -1};	// neighbours seen recently (-1 = free entry)
+signed int irCommNeighbourBearing[IRCOMM_MAX_NEIGHBOURS];
+unsigned int irCommNeighbourDistance[IRCOMM_MAX_NEIGHBOURS];
+unsigned long int irCommNeighbourTime[IRCOMM_MAX_NEIGHBOURS];	// last time the neighbour was perceived
 
 // transmission
 unsigned char irCommAdcTxState = 0;
 unsigned char irCommTxByte = 0;
 unsigned char irCommTxByteEnqueued = 0;
 unsigned long int irCommTxLastTransmissionTime = 0;	// used for min pause between bytes transmission
+unsigned long int irCommRxLastBusyTime = 0;			// last time a signal was perceived (carrier sense)
+unsigned long int irCommTxBackoffStart = 0;
+unsigned int irCommTxBackoff = 0;					// random time to wait before transmitting (adc isr of 104 us)
+unsigned char irCommTxBackoffExp = 0;				// number of consecutive times the channel was found busy
+unsigned int irCommTxCount = 0;						// statistics: bytes transmitted
+unsigned int irCommTxDeferredCount = 0;				// statistics: transmissions deferred because the channel was busy
+unsigned int irCommRxErrorCount = 0;				// statistics: bytes received with wrong crc (e.g. collisions)
 unsigned char irCommTxBitToTransmit[12];
 unsigned char irCommTxCrc = 0;
 unsigned char irCommTxBitCount = 0;
 unsigned char irCommTxPulseState = 0;
 unsigned int irCommTxDuration = 0;
 unsigned char irCommTxSwitchCount = 0;
+unsigned char irCommTxBitTotal = 12;					// number of entries in "irCommTxBitToTransmit" to be sent
+unsigned long int irCommTxManchester = 0;			// levels of the half bits in Manchester mode (bit 0 = first half bit, 1 = IR on)
 unsigned char irCommTxSwitchCounter = 0;
 unsigned char irCommTxDurationCycle = 0;
-unsigned char irCommTxSensorMask = 0;
+unsigned char irCommTxSensorMask = 0xFF;				// sensors selected for the transmission
+unsigned char irCommTxSensorCount = 0;
+unsigned char irCommTxPattern = 0xAA;				// sensors currently pulsed (PORTA)
+
+// ground and proximity sensors sampling during IR communication
+unsigned char irCommGroundEnabled = 1;				// sample the ground sensors (cliff avoidance) also while communicating
+unsigned char irCommInterleaveState = IRCOMM_INTERLEAVE_IDLE;
+unsigned char irCommGroundIndex = 0;				// ground sample to take (0..7), even = ambient, odd = active phase
+unsigned char irCommProxEnabled = 1;				// sample the proximity sensors (obstacle avoidance) also while communicating
+unsigned char irCommProxIndex = 0;					// proximity sample to take (0..15), even = ambient, odd = active phase
+unsigned char irCommInterleaveProx = 0;				// the current interleaved sample is a proximity (1) or a ground (0)
+unsigned char irCommInterleaveChannel = 0;			// adc channel of the current interleaved sample
+unsigned char irCommInterleaveTxCounter = 0;
 unsigned char irCommTxSensorGroup = 0;
 
+// packets
+unsigned char irCommTxQueue[IRCOMM_QUEUE_SIZE];		// bytes of the packets waiting to be sent
+unsigned char irCommTxQueueHead = 0;
+unsigned char irCommTxQueueTail = 0;
+unsigned char irCommTxPktSeq = 0;					// sequence number of the next packet sent
+unsigned char irCommRxQueue[IRCOMM_QUEUE_SIZE];		// received packets: length, sender, sequence, sensor, payload
+unsigned char irCommRxQueueHead = 0;
+unsigned char irCommRxQueueTail = 0;
+unsigned char irCommRxPktState = IRCOMM_PKT_WAIT_START;
+unsigned char irCommRxPktBuff[IRCOMM_PKT_MAX_PAYLOAD+3];	// packet being received: length, sender, sequence, payload
+unsigned char irCommRxPktIndex = 0;
+unsigned long int irCommRxPktLastByteTime = 0;
+
+/**************/
+/*** LOGGER ***/
+/**************/
+signed int logBuffer[LOG_BUFF_WORDS];				// frames recorded, each frame contains one sample of each channel
+volatile signed int *logSource[LOG_MAX_CHANNELS];	// address of the variables recorded
+volatile unsigned char logState = LOG_IDLE;
+unsigned char logNumCh = 0;							// number of channels recorded
+unsigned int logCapacity = 0;						// frames that fit in the buffer
+unsigned int logDecimation = 1;
+unsigned int logDecimCounter = 0;
+unsigned int logHead = 0;							// where the next frame will be written
+unsigned int logCount = 0;							// frames available
+unsigned int logPretrigger = 0;
+unsigned int logRemaining = 0;						// frames to record after the trigger
+signed char logTrigChannel = -1;					// position in the channels list, -1 => no trigger
+signed int logTrigLevel = 0;
+signed int logTrigPrev = 0;
+unsigned char logTrigFirst = 1;
+signed int logDumpEvent = -1;						// event used to send the buffer to the computer, -1 => no dump in progress
+unsigned int logDumpIndex = 0;						// next frame to send
+
+/*****************/
+/*** BLACK BOX ***/
+/*****************/
+unsigned char blackBoxHead = 0;						// eeprom location (record) of the next event
+unsigned char blackBoxCount = 0;					// records saved in eeprom
+unsigned int blackBoxSeq = 0;						// sequence number of the next event
+unsigned char blackBoxQueue[BLACKBOX_QUEUE_SIZE][BLACKBOX_RECORD_SIZE];	// events waiting to be written
+unsigned char blackBoxQueueTail = 0;
+unsigned char blackBoxQueueNum = 0;
+unsigned char blackBoxByteIndex = 0;				// bytes of the oldest queued event already written
+unsigned char blackBoxCliffPrev = 0;
+unsigned long int blackBoxCliffTime = 0;			// last cliff detection logged
+
+/***********************/
+/*** ASSERT RECOVERY ***/
+/***********************/
+// not initialized at startup, thus they keep their values through a watchdog reset
+unsigned char mcusrMirror __attribute__ ((section (".noinit")));	// reset flags (MCUSR) saved before being cleared
+unsigned int assertMagic __attribute__ ((section (".noinit")));	// ASSERT_MAGIC when the following values are valid
+unsigned char assertReason __attribute__ ((section (".noinit")));	// reason of the last assert
+unsigned char assertCount __attribute__ ((section (".noinit")));	// consecutive asserts (reset by the watchdog in between)
+
+/************/
+/*** IDLE ***/
+/************/
+volatile unsigned char cpuSleeping = 0;			// the main loop is waiting for an interrupt in idle mode
+unsigned int idleTicks = 0;							// adc interrupts occurred while in idle mode
+unsigned int idleMeasureTicks = 0;
+volatile unsigned int idleTicksLast = 0;			// idle adc interrupts in the last IDLE_MEASURE_PERIOD
+
 
 
 
@@ -13,6 +13,8 @@ extern volatile unsigned int proximityValue[24];
 extern int proximityResult[12];
 extern signed int proximityOffset[12];
 extern unsigned long proximitySum[12];
+extern signed long int proximityBaseline[8];
+extern unsigned char proxBaselineEnabled;
 extern unsigned char adcSaveDataTo;
 extern unsigned char adcSamplingState;
 extern unsigned char rightChannelPhase;
@@ -69,13 +71,45 @@ extern unsigned int dataLED[3];
 extern signed int speedl;
 extern signed int speedr;
 extern unsigned char rfData[PAYLOAD_SIZE];
-extern unsigned char ackPayload[16];
+extern unsigned char ackPayload[ACK_PAYLOAD_SIZE];
 extern unsigned char packetId;
+extern unsigned char rfAckSchedule[RF_ACK_SCHEDULE_SIZE];
+extern unsigned char rfAckScheduleLen;
+extern unsigned char rfAckScheduleIndex;
+extern volatile unsigned char rfPollEnabled;
+extern volatile unsigned char rfPollBusy;
+extern volatile unsigned char rfDataReady;
+extern unsigned char rfPollCounter;
+extern unsigned char rfGroupId;
+extern unsigned int rfGroupCmdSeq;
+extern unsigned char rfGroupCmdPending;
+extern unsigned char rfGroupCmdType;
+extern unsigned char rfGroupCmdIndex;
+extern signed int rfGroupCmdValue;
+extern unsigned long int rfGroupCmdTime;
+extern volatile unsigned long int rfDataReadyTime;
+extern unsigned char rfTimeSyncState;
+extern signed long int rfTimeOffset;
+extern signed long int rfTimeDriftQ16;
+extern unsigned long int rfTimeLastLocal;
+extern unsigned long int rfTimeLastMaster;
 extern unsigned int rfAddress;
 extern unsigned char rfFlags;
 extern unsigned char spiCommError;
 extern unsigned char rfDebugMode;
+extern unsigned char rfLegacyCommandsEnabled;
 extern unsigned char rfDebugCounter;
+extern unsigned char rfAsebaRxBuff[RF_ASEBA_RX_BUFF_SIZE];
+extern unsigned int rfAsebaRxHead;
+extern unsigned int rfAsebaRxTail;
+extern unsigned char rfAsebaTxBuff[RF_ASEBA_BUFF_SIZE];
+extern unsigned char rfAsebaTxHead;
+extern unsigned char rfAsebaTxTail;
+extern unsigned char rfAsebaRxSeq;
+extern unsigned char rfAsebaTxSeq;
+extern unsigned char rfAsebaTxLen;
+extern unsigned char rfAsebaConnected;
+extern unsigned long int rfAsebaLastFrameTime;
 
 /****************/
 /*** RGB LEDS ***/
@@ -118,6 +152,7 @@ extern uint32_t lastCmdTime;
 /*********************/
 extern int accelAddress;
 extern unsigned char useAccel;
+extern unsigned long accelI2cClock;
 extern signed int accX;
 extern signed int accY;
 extern signed int accZ;
@@ -140,6 +175,10 @@ extern uint32_t clockTick;
 extern unsigned char currentSelector;
 extern signed int calibrationCycle;
 extern unsigned char startCalibration;
+extern unsigned char calibrationState;
+extern unsigned char calibrationNext;
+extern uint32_t calibrationTick;
+extern unsigned int calibrationCounter;
 extern unsigned char hardwareRevision;
 extern unsigned char currentOsccal;
 extern unsigned long long int speedStepCounter;
@@ -166,6 +205,10 @@ extern float theta, lastTheta, xPos, yPos, deltaDist;
 extern float leftDist, rightDist, leftDistPrev, rightDistPrev;
 extern unsigned char computeOdometry;
 extern float thetaAcc;
+extern signed int thetaAccQ12;
+extern signed long int thetaFusedQ12;
+extern signed long int thetaWheelPrevQ12;
+extern unsigned char headingConfidence;
 extern unsigned char calibState;
 extern unsigned char calibVelIndex;
 extern unsigned char calibWheel;
@@ -196,9 +239,11 @@ extern int calibrationThr;
 extern unsigned char irCommEnabled;
 extern unsigned char irCommEnabledNext;
 extern unsigned char irCommMode;
+extern unsigned char irCommLineCode;
 extern volatile unsigned char irCommState;
 extern unsigned int irCommTempValue;
 extern volatile unsigned char irCommSendValues;
+extern unsigned char irCommCaptureCrc;
 extern unsigned long int irCommTickCounter;
 extern unsigned long int irCommTickCounter2;
 extern unsigned char irCommTickCounterUpdate;
@@ -231,12 +276,16 @@ extern unsigned char irCommComputeShift;
 extern signed int irCommProxMean;
 extern signed char irCommSignalState;
 extern unsigned char irCommSwitchCount;
+extern signed long int irCommPowerBit0;
+extern signed long int irCommPowerBit1;
 extern unsigned char irCommRxBitCount;
 extern unsigned char irCommRxCrcError;
 extern unsigned char irCommRxByte;
 extern unsigned char irCommSecondBitSkipped;
 extern unsigned char irCommShiftCounter;
 extern unsigned char irCommRxBitReceived[10];
+extern unsigned char irCommRxBitConfidence[10];
+extern unsigned char irCommRxLastConfidence;
 extern unsigned char irCommRxByteExpected;
 extern unsigned char irCommRxSequenceCount;
 extern unsigned char irCommRxLastDataReceived;
@@ -249,23 +298,116 @@ extern unsigned char irCommRxStartPeakDuration;
 extern signed int irCommRxMaxDiff;
 extern signed int irCommRxMaxSensor;
 extern unsigned char irCommRxNumReceivingSensors;
+extern unsigned char irCommRxDiversityEnabled;
+extern unsigned int irCommRxSensorAmplitude[8];
+extern unsigned int irCommRxSensorStrength[8];
+extern signed int irCommRxBearing;
+extern unsigned int irCommRxDistance;
+extern signed int irCommNeighbourId[IRCOMM_MAX_NEIGHBOURS];
+extern signed int irCommNeighbourBearing[IRCOMM_MAX_NEIGHBOURS];
+extern unsigned int irCommNeighbourDistance[IRCOMM_MAX_NEIGHBOURS];
+extern unsigned long int irCommNeighbourTime[IRCOMM_MAX_NEIGHBOURS];
 
 // transmission
 extern unsigned char irCommAdcTxState;
 extern unsigned char irCommTxByte;
 extern unsigned char irCommTxByteEnqueued;
 extern unsigned long int irCommTxLastTransmissionTime;
+extern unsigned long int irCommRxLastBusyTime;
+extern unsigned long int irCommTxBackoffStart;
+extern unsigned int irCommTxBackoff;
+extern unsigned char irCommTxBackoffExp;
+extern unsigned int irCommTxCount;
+extern unsigned int irCommTxDeferredCount;
+extern unsigned int irCommRxErrorCount;
 extern unsigned char irCommTxBitToTransmit[12];
 extern unsigned char irCommTxCrc;
 extern unsigned char irCommTxBitCount;
 extern unsigned char irCommTxPulseState;
 extern unsigned int irCommTxDuration;
 extern unsigned char irCommTxSwitchCount;
+extern unsigned char irCommTxBitTotal;
+extern unsigned long int irCommTxManchester;
 extern unsigned char irCommTxSwitchCounter;
 extern unsigned char irCommTxDurationCycle;
 extern unsigned char irCommTxSensorMask;
+extern unsigned char irCommTxSensorCount;
+extern unsigned char irCommTxPattern;
+
+// ground sensors sampling during IR communication
+extern unsigned char irCommGroundEnabled;
+extern unsigned char irCommInterleaveState;
+extern unsigned char irCommGroundIndex;
+extern unsigned char irCommProxEnabled;
+extern unsigned char irCommProxIndex;
+extern unsigned char irCommInterleaveProx;
+extern unsigned char irCommInterleaveChannel;
+extern unsigned char irCommInterleaveTxCounter;
 extern unsigned char irCommTxSensorGroup;
 
+// packets
+extern unsigned char irCommTxQueue[IRCOMM_QUEUE_SIZE];
+extern unsigned char irCommTxQueueHead;
+extern unsigned char irCommTxQueueTail;
+extern unsigned char irCommTxPktSeq;
+extern unsigned char irCommRxQueue[IRCOMM_QUEUE_SIZE];
+extern unsigned char irCommRxQueueHead;
+extern unsigned char irCommRxQueueTail;
+extern unsigned char irCommRxPktState;
+extern unsigned char irCommRxPktBuff[IRCOMM_PKT_MAX_PAYLOAD+3];
+extern unsigned char irCommRxPktIndex;
+extern unsigned long int irCommRxPktLastByteTime;
+
+/**************/
+/*** LOGGER ***/
+/**************/
+extern signed int logBuffer[LOG_BUFF_WORDS];
+extern volatile signed int *logSource[LOG_MAX_CHANNELS];
+extern volatile unsigned char logState;
+extern unsigned char logNumCh;
+extern unsigned int logCapacity;
+extern unsigned int logDecimation;
+extern unsigned int logDecimCounter;
+extern unsigned int logHead;
+extern unsigned int logCount;
+extern unsigned int logPretrigger;
+extern unsigned int logRemaining;
+extern signed char logTrigChannel;
+extern signed int logTrigLevel;
+extern signed int logTrigPrev;
+extern unsigned char logTrigFirst;
+extern signed int logDumpEvent;
+extern unsigned int logDumpIndex;
+
+/*****************/
+/*** BLACK BOX ***/
+/*****************/
+extern unsigned char blackBoxHead;
+extern unsigned char blackBoxCount;
+extern unsigned int blackBoxSeq;
+extern unsigned char blackBoxQueue[BLACKBOX_QUEUE_SIZE][BLACKBOX_RECORD_SIZE];
+extern unsigned char blackBoxQueueTail;
+extern unsigned char blackBoxQueueNum;
+extern unsigned char blackBoxByteIndex;
+extern unsigned char blackBoxCliffPrev;
+extern unsigned long int blackBoxCliffTime;
+
+/***********************/
+/*** ASSERT RECOVERY ***/
+/***********************/
+extern unsigned char mcusrMirror;
+extern unsigned int assertMagic;
+extern unsigned char assertReason;
+extern unsigned char assertCount;
+
+/************/
+/*** IDLE ***/
+/************/
+extern volatile unsigned char cpuSleeping;
+extern unsigned int idleTicks;
+extern unsigned int idleMeasureTicks;
+extern volatile unsigned int idleTicksLast;
+
 
 
 